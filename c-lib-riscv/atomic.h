@@ -0,0 +1,72 @@
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+#include <stdint.h>
+
+// the compiler targets plain rv32i, so it would turn c11 atomics into calls.
+// the a extension is enabled just for these instructions instead.
+
+#define fence asm volatile("fence rw, rw" ::: "memory")
+
+static inline uint32_t amoswap(volatile uint32_t *p, uint32_t v) {
+  uint32_t old;
+  asm volatile(".option push\n"
+               ".option arch, +a\n"
+               "amoswap.w.aqrl %0, %2, %1\n"
+               ".option pop"
+               : "=r"(old), "+A"(*p)
+               : "r"(v)
+               : "memory");
+  return old;
+}
+
+static inline uint32_t amoadd(volatile uint32_t *p, uint32_t v) {
+  uint32_t old;
+  asm volatile(".option push\n"
+               ".option arch, +a\n"
+               "amoadd.w.aqrl %0, %2, %1\n"
+               ".option pop"
+               : "=r"(old), "+A"(*p)
+               : "r"(v)
+               : "memory");
+  return old;
+}
+
+static inline uint32_t amoor(volatile uint32_t *p, uint32_t v) {
+  uint32_t old;
+  asm volatile(".option push\n"
+               ".option arch, +a\n"
+               "amoor.w.aqrl %0, %2, %1\n"
+               ".option pop"
+               : "=r"(old), "+A"(*p)
+               : "r"(v)
+               : "memory");
+  return old;
+}
+
+static inline uint32_t amoand(volatile uint32_t *p, uint32_t v) {
+  uint32_t old;
+  asm volatile(".option push\n"
+               ".option arch, +a\n"
+               "amoand.w.aqrl %0, %2, %1\n"
+               ".option pop"
+               : "=r"(old), "+A"(*p)
+               : "r"(v)
+               : "memory");
+  return old;
+}
+
+// plain loads and stores ordered by a fence, see table A.6 mappings from c/c++
+// primitives to risc-v primitives
+static inline uint32_t load_acquire(volatile uint32_t *p) {
+  uint32_t v = *p;
+  asm volatile("fence r, rw" ::: "memory");
+  return v;
+}
+
+static inline void store_release(volatile uint32_t *p, uint32_t v) {
+  asm volatile("fence rw, w" ::: "memory");
+  *p = v;
+}
+
+#endif
@@ -0,0 +1,447 @@
+#include "bcache.h"
+#include "atomic.h"
+#include "console.h"
+#include "softirq.h"
+#include "spinlock.h"
+
+#define BUF_READAHEAD (1 << 4) // brought in by read ahead, not yet used
+
+#define MAX_DEVS (4)
+
+struct bucket {
+  struct spinlock lock;
+  struct buf *head;
+};
+
+static struct bucket buckets[BCACHE_BUCKETS];
+
+// headers are only allocated on a miss, a single lock is fine for them. it
+// also protects the clock hand
+static struct buf bufs[BCACHE_MAX_BUFS];
+static struct buf *free_bufs;
+static size_t free_init;
+static size_t hand;
+static struct spinlock alloc_lock;
+
+static volatile uint32_t ndirty;
+static volatile uint32_t flush_queued;
+
+// the last block read per device and how many reads in a row were
+// sequential. updates may race, it is only a hint
+static struct {
+  uint32_t last;
+  uint32_t run;
+} streams[MAX_DEVS];
+
+static struct {
+  volatile uint32_t hits;
+  volatile uint32_t misses;
+  volatile uint32_t readahead;
+  volatile uint32_t readahead_hits;
+  volatile uint32_t evictions;
+  volatile uint32_t writebacks;
+  volatile uint32_t batches;
+} stats;
+
+static inline struct bucket *bucket(uint32_t dev, uint32_t block) {
+  return &buckets[(block * 31 + dev) % BCACHE_BUCKETS];
+}
+
+static inline uint64_t sector(struct buf *b) {
+  return (uint64_t)b->block * (BCACHE_BLOCK_SIZE / BLK_SECTOR_SIZE);
+}
+
+static void evict();
+
+static struct buf *lookup(struct bucket *bk, uint32_t dev, uint32_t block) {
+  for (struct buf *b = bk->head; b; b = b->hnext)
+    if (b->dev == dev && b->block == block)
+      return b;
+  return NULL;
+}
+
+static struct buf *buf_alloc() {
+  if (page_free_count() < BCACHE_LOW_WATER)
+    evict();
+
+  uint8_t *data = page_alloc();
+  if (!data)
+    return NULL;
+
+  size_t sie = irq_save();
+  spin_lock(&alloc_lock);
+  struct buf *b = free_bufs;
+  if (b)
+    free_bufs = b->hnext;
+  else if (free_init < BCACHE_MAX_BUFS)
+    b = &bufs[free_init++];
+  spin_unlock(&alloc_lock);
+  irq_restore(sie);
+
+  if (!b) {
+    page_free(data);
+    return NULL;
+  }
+
+  b->data = data;
+  b->hnext = NULL;
+  return b;
+}
+
+static void buf_free(struct buf *b) {
+  page_free(b->data);
+  b->data = NULL;
+
+  size_t sie = irq_save();
+  spin_lock(&alloc_lock);
+  b->hnext = free_bufs;
+  free_bufs = b;
+  spin_unlock(&alloc_lock);
+  irq_restore(sie);
+}
+
+// the clock. sweep the headers, giving blocks used since the last pass a
+// second chance, until enough pages are free again or a full turn is done
+static void evict() {
+  size_t sie = irq_save();
+  spin_lock(&alloc_lock);
+
+  for (size_t n = 0; n < 2 * free_init; n++) {
+    if (page_free_count() >= 2 * BCACHE_LOW_WATER)
+      break;
+
+    struct buf *b = &bufs[hand];
+    hand = (hand + 1) % free_init;
+
+    if (!b->data || b->refcnt || (b->flags & (BUF_BUSY | BUF_DIRTY)))
+      continue;
+
+    if (amoand(&b->flags, ~BUF_REF) & BUF_REF)
+      continue;
+
+    struct bucket *bk = bucket(b->dev, b->block);
+    spin_lock(&bk->lock);
+
+    // recheck with the bucket locked, a lookup may have taken a reference
+    int victim = !b->refcnt && !(b->flags & (BUF_BUSY | BUF_DIRTY));
+    if (victim) {
+      struct buf **pp = &bk->head;
+      while (*pp != b)
+        pp = &(*pp)->hnext;
+      *pp = b->hnext;
+    }
+
+    spin_unlock(&bk->lock);
+
+    if (victim) {
+      // dont call buf_free, the lock is held already
+      page_free(b->data);
+      b->data = NULL;
+      b->hnext = free_bufs;
+      free_bufs = b;
+      amoadd(&stats.evictions, 1);
+    }
+  }
+
+  spin_unlock(&alloc_lock);
+  irq_restore(sie);
+}
+
+// runs in the bottom half of the block device, or in blk_poll
+static void read_done(struct blk_req *r) {
+  struct buf *b = r->priv;
+  if (r->status == VIRTIO_BLK_S_OK)
+    amoor(&b->flags, BUF_VALID);
+  amoand(&b->flags, ~BUF_BUSY);
+}
+
+// a read that could not be queued. the device never wrote its status, the
+// one from prepare would read as success
+static void read_failed(struct blk_req *r) {
+  r->status = VIRTIO_BLK_S_IOERR;
+  read_done(r);
+}
+
+static void prepare(struct buf *b, int write) {
+  b->req = (struct blk_req){
+      .sector = sector(b),
+      .write = write,
+      .nsegs = 1,
+      .segs = {{b->data, BCACHE_BLOCK_SIZE}},
+      .complete = write ? NULL : read_done,
+      .priv = b,
+  };
+}
+
+// insert a new block, unless another hart was faster. flags are set before
+// it is visible. returns the block in the cache, and whether it is ours
+static struct buf *insert(uint32_t dev, uint32_t block, uint32_t flags,
+                          uint32_t ref, int *ours) {
+  struct buf *nb = buf_alloc();
+  if (!nb)
+    return NULL;
+
+  nb->dev = dev;
+  nb->block = block;
+  nb->flags = flags;
+  nb->refcnt = ref;
+
+  struct bucket *bk = bucket(dev, block);
+  size_t sie = irq_save();
+  spin_lock(&bk->lock);
+
+  struct buf *b = lookup(bk, dev, block);
+  if (!b) {
+    nb->hnext = bk->head;
+    bk->head = nb;
+    b = nb;
+  } else if (ref) {
+    b->refcnt++;
+  }
+
+  spin_unlock(&bk->lock);
+  irq_restore(sie);
+
+  *ours = b == nb;
+  if (!*ours)
+    buf_free(nb);
+
+  return b;
+}
+
+static void readahead(uint32_t dev, uint32_t from) {
+  struct blk_req *batch[BCACHE_READAHEAD];
+  uint64_t blocks = blk_capacity() / (BCACHE_BLOCK_SIZE / BLK_SECTOR_SIZE);
+  size_t n = 0;
+
+  for (uint32_t block = from; block < from + BCACHE_READAHEAD; block++) {
+    if (block >= blocks)
+      break;
+
+    struct bucket *bk = bucket(dev, block);
+    size_t sie = irq_save();
+    spin_lock(&bk->lock);
+    int cached = lookup(bk, dev, block) != NULL;
+    spin_unlock(&bk->lock);
+    irq_restore(sie);
+    if (cached)
+      continue;
+
+    // not referenced, busy keeps it from being evicted until it is read
+    int ours;
+    struct buf *b = insert(dev, block, BUF_BUSY | BUF_READAHEAD, 0, &ours);
+    if (!b)
+      break;
+    if (!ours)
+      continue;
+
+    prepare(b, 0);
+    batch[n++] = &b->req;
+  }
+
+  if (n) {
+    amoadd(&stats.readahead, n);
+    // dont wait, the completions mark the blocks valid
+    size_t queued = blk_submit(batch, n);
+    for (size_t i = queued; i < n; i++)
+      read_failed(batch[i]);
+  }
+}
+
+struct buf *bread(uint32_t dev, uint32_t block) {
+  struct bucket *bk = bucket(dev, block);
+  struct buf *b;
+  int ours = 0;
+
+  if (dev >= MAX_DEVS || !blk_present())
+    return NULL;
+
+  size_t sie = irq_save();
+  spin_lock(&bk->lock);
+  b = lookup(bk, dev, block);
+  if (b)
+    b->refcnt++;
+  spin_unlock(&bk->lock);
+  irq_restore(sie);
+
+  if (b) {
+    amoadd(&stats.hits, 1);
+    if (amoand(&b->flags, ~BUF_READAHEAD) & BUF_READAHEAD)
+      amoadd(&stats.readahead_hits, 1);
+  } else {
+    b = insert(dev, block, BUF_BUSY, 1, &ours);
+    if (!b)
+      return NULL;
+    amoadd(&stats.misses, 1);
+  }
+
+  amoor(&b->flags, BUF_REF);
+
+  // detect sequential streams, and read ahead before the reader gets there
+  if (block == streams[dev].last + 1)
+    streams[dev].run++;
+  else
+    streams[dev].run = 0;
+  streams[dev].last = block;
+
+  if (ours) {
+    prepare(b, 0);
+    struct blk_req *r = &b->req;
+    if (!blk_submit(&r, 1))
+      read_failed(r);
+  }
+
+  if (streams[dev].run >= 2)
+    readahead(dev, block + 1);
+
+  // the block may be in flight, for this read, another one or read ahead
+  while (b->flags & BUF_BUSY)
+    blk_wait(&b->req);
+
+  // a failed read ahead or a read that could not be queued, try again
+  if (!(b->flags & BUF_VALID) && !(amoor(&b->flags, BUF_BUSY) & BUF_BUSY)) {
+    prepare(b, 0);
+    struct blk_req *r = &b->req;
+    if (blk_submit(&r, 1))
+      blk_wait(r);
+    else
+      read_failed(r);
+  }
+
+  while (b->flags & BUF_BUSY)
+    blk_wait(&b->req);
+
+  if (!(b->flags & BUF_VALID)) {
+    brelse(b);
+    return NULL;
+  }
+
+  return b;
+}
+
+static void flush_work(size_t arg) {
+  bflush();
+  store_release(&flush_queued, 0);
+}
+
+void bdirty(struct buf *b) {
+  if (!(amoor(&b->flags, BUF_DIRTY) & BUF_DIRTY))
+    amoadd(&ndirty, 1);
+}
+
+void brelse(struct buf *b) {
+  struct bucket *bk = bucket(b->dev, b->block);
+  size_t sie = irq_save();
+  spin_lock(&bk->lock);
+  b->refcnt--;
+  spin_unlock(&bk->lock);
+  irq_restore(sie);
+
+  // enough for a batch, let the worker write them back
+  if (ndirty >= BCACHE_WRITEBACK_BATCH && !amoswap(&flush_queued, 1))
+    work_queue(hartid(), flush_work, 0);
+}
+
+void bflush() {
+  struct blk_req *batch[BCACHE_WRITEBACK_BATCH];
+  struct buf *b;
+
+  for (size_t i = 0; i < free_init;) {
+    size_t n = 0;
+
+    for (; i < free_init && n < BCACHE_WRITEBACK_BATCH; i++) {
+      b = &bufs[i];
+      if (!b->data || !(b->flags & BUF_DIRTY))
+        continue;
+      if (amoor(&b->flags, BUF_BUSY) & BUF_BUSY)
+        continue;
+
+      // cleared before the write, so a write to the block in the meantime
+      // marks it dirty again
+      amoand(&b->flags, ~BUF_DIRTY);
+      amoadd(&ndirty, -1);
+      prepare(b, 1);
+      batch[n++] = &b->req;
+    }
+
+    if (!n)
+      continue;
+
+    size_t queued = blk_submit(batch, n);
+    amoadd(&stats.batches, 1);
+
+    for (size_t k = 0; k < n; k++) {
+      b = batch[k]->priv;
+      if (k < queued)
+        blk_wait(batch[k]);
+
+      if (k >= queued || batch[k]->status != VIRTIO_BLK_S_OK)
+        bdirty(b);
+      else
+        amoadd(&stats.writebacks, 1);
+
+      amoand(&b->flags, ~BUF_BUSY);
+    }
+  }
+}
+
+void bcache_report() {
+  uint32_t lookups = stats.hits + stats.misses;
+
+  print("cache: hits ");
+  print_num(10, stats.hits);
+  print(", misses ");
+  print_num(10, stats.misses);
+  print(", hit rate % ");
+  print_num(10, lookups ? stats.hits * 100 / lookups : 0);
+  print("\n  readahead ");
+  print_num(10, stats.readahead);
+  print(", readahead hits ");
+  print_num(10, stats.readahead_hits);
+  print(", evictions ");
+  print_num(10, stats.evictions);
+  print("\n  writebacks ");
+  print_num(10, stats.writebacks);
+  print(", batches ");
+  print_num(10, stats.batches);
+  print(", dirty ");
+  print_num(10, ndirty);
+  print("\n");
+}
+
+#define BENCH_BLOCKS (128)
+
+static uint64_t bench_pass() {
+  uint64_t start = rdtime();
+  for (uint32_t block = 0; block < BENCH_BLOCKS; block++) {
+    struct buf *b = bread(0, block);
+    if (!b)
+      break;
+    brelse(b);
+  }
+  return rdtime() - start;
+}
+
+void bcache_bench() {
+  uint64_t sectors =
+      (uint64_t)BENCH_BLOCKS * BCACHE_BLOCK_SIZE / BLK_SECTOR_SIZE;
+
+  if (!blk_present() || blk_capacity() < sectors) {
+    print("cache: no disk\n");
+    return;
+  }
+
+  // the first pass misses, unless an earlier run left the blocks cached
+  for (int pass = 0; pass < 2; pass++) {
+    uint64_t ticks = bench_pass();
+    if (!ticks)
+      ticks = 1;
+
+    print(pass ? "cache: warm, KB/s " : "cache: cold, KB/s ");
+    print_num(10, (uint64_t)BENCH_BLOCKS * (BCACHE_BLOCK_SIZE / 1024) *
+                      TIMEBASE_HZ / ticks);
+    print("\n");
+  }
+
+  bcache_report();
+}
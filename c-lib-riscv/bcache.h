@@ -0,0 +1,63 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include "page.h"
+#include "virtio_blk.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// a cache of disk blocks, keyed by device and block number.
+//
+// lookups only lock the hash bucket they hit, so harts dont contend unless
+// they hash to the same bucket. the cache grows as long as pages are
+// available. once the page allocator runs low, a clock sweep evicts clean,
+// unused blocks. dirty blocks are written back in batches. sequential reads
+// are detected per device and the following blocks are read ahead, without
+// waiting for them.
+
+#define BCACHE_BLOCK_SIZE (PAGE_SIZE)
+#define BCACHE_BUCKETS (256)
+#define BCACHE_MAX_BUFS (1024)
+
+// evict, once fewer pages than this are free
+#define BCACHE_LOW_WATER (256)
+// blocks read ahead, once a sequential stream is detected
+#define BCACHE_READAHEAD (8)
+// dirty blocks written back with a single notification
+#define BCACHE_WRITEBACK_BATCH (16)
+
+#define BUF_VALID (1 << 0) // data matches the disk, or is newer
+#define BUF_DIRTY (1 << 1) // data is newer than the disk
+#define BUF_BUSY (1 << 2)  // i/o in flight
+#define BUF_REF (1 << 3)   // used since the clock hand passed
+
+struct buf {
+  uint32_t dev;
+  uint32_t block;
+  uint8_t *data;
+
+  volatile uint32_t refcnt;
+  volatile uint32_t flags;
+
+  struct buf *hnext;
+  struct blk_req req;
+};
+
+// returns the block with a reference held and valid data, or NULL on error
+struct buf *bread(uint32_t dev, uint32_t block);
+
+// mark the data as modified. it is written back by bflush
+void bdirty(struct buf *b);
+
+void brelse(struct buf *b);
+
+// write back all dirty blocks, in batches
+void bflush();
+
+// hit rate, misses, evictions and write back stats
+void bcache_report();
+
+// read the first blocks of the disk sequentially, cold and warm
+void bcache_bench();
+
+#endif
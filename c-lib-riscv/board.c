@@ -0,0 +1,253 @@
+#include "board.h"
+#include "config.h"
+#include "console.h"
+#include "fdt.h"
+
+extern char _start[];
+
+struct board board = {
+#ifdef BOARD_QEMU_RISCV_VIRT
+    .memory = {{0x80000000, 0x88000000}},
+    .nmemory = 1,
+    .harts = MAX_HARTS,
+    .timebase_hz = 10000000,
+    .uart = {0x10000000, 10},
+    .clint = {0x02000000, 0},
+    .plic = 0x0c000000,
+    .plic_size = 0x600000,
+    .plic_sources = 95,
+    .virtio =
+        {
+            {0x10001000, 1},
+            {0x10002000, 2},
+            {0x10003000, 3},
+            {0x10004000, 4},
+            {0x10005000, 5},
+            {0x10006000, 6},
+            {0x10007000, 7},
+            {0x10008000, 8},
+        },
+    .nvirtio = 8,
+    // qemu loads the -initrd archive halfway into ram, for boards with less
+    // than 256M, or at 128M, above the kernel. the end is found by parsing it
+    .initrd = {0x84000000, 0},
+#endif
+};
+
+// the state of a node, while it is walked. most properties are only
+// interpreted once the node ends, by then its compatible is known
+struct node {
+  // for the reg of the children
+  uint32_t address_cells, size_cells;
+
+  uint64_t reg[2 * BOARD_MAX_MEMORY];
+  size_t nreg;
+  uint32_t irq;
+  uint32_t ndev;
+  uint32_t timebase;
+  uint64_t initrd_start, initrd_end;
+
+  uint32_t memory : 1;
+  uint32_t cpu : 1;
+  uint32_t uart : 1;
+  uint32_t plic : 1;
+  uint32_t clint : 1;
+  uint32_t virtio : 1;
+  uint32_t chosen : 1;
+  uint32_t disabled : 1;
+};
+
+struct state {
+  struct node nodes[FDT_MAX_DEPTH];
+  size_t harts;
+  size_t nmemory;
+  size_t nvirtio;
+  int initrd;
+};
+
+static int streq(const char *a, const char *b) {
+  while (*a && *a == *b)
+    a++, b++;
+  return *a == *b;
+}
+
+static void begin(void *ctx, int depth, const char *name) {
+  struct state *s = ctx;
+  struct node *n = &s->nodes[depth];
+
+  *n = (struct node){.address_cells = 2, .size_cells = 1};
+  n->chosen = depth == 1 && streq(name, "chosen");
+}
+
+static void prop(void *ctx, int depth, const char *name, const void *value,
+                 uint32_t len) {
+  struct state *s = ctx;
+  struct node *n = &s->nodes[depth];
+  struct node *parent = depth ? &s->nodes[depth - 1] : n;
+
+  if (streq(name, "#address-cells") && len == 4) {
+    n->address_cells = fdt32(value);
+  } else if (streq(name, "#size-cells") && len == 4) {
+    n->size_cells = fdt32(value);
+  } else if (streq(name, "reg")) {
+    uint32_t ac = parent->address_cells, sc = parent->size_cells;
+    uint32_t stride = (ac + sc) * 4;
+    if (ac < 1 || ac > 2 || sc > 2)
+      return;
+    for (uint32_t off = 0;
+         off + stride <= len && n->nreg < 2 * BOARD_MAX_MEMORY; off += stride) {
+      n->reg[n->nreg++] = fdt_cells((const uint8_t *)value + off, ac);
+      n->reg[n->nreg++] =
+          sc ? fdt_cells((const uint8_t *)value + off + ac * 4, sc) : 0;
+    }
+  } else if (streq(name, "interrupts") && len >= 4) {
+    n->irq = fdt32(value);
+  } else if (streq(name, "riscv,ndev") && len == 4) {
+    n->ndev = fdt32(value);
+  } else if (streq(name, "timebase-frequency") && len == 4) {
+    // on /cpus, or on the cpu nodes
+    n->timebase = fdt32(value);
+  } else if (streq(name, "status")) {
+    n->disabled = !fdt_strlist(value, len, "okay") &&
+                  !fdt_strlist(value, len, "ok");
+  } else if (streq(name, "device_type")) {
+    n->memory = fdt_strlist(value, len, "memory");
+    n->cpu = fdt_strlist(value, len, "cpu");
+  } else if (streq(name, "compatible")) {
+    n->uart = fdt_strlist(value, len, "ns16550a") ||
+              fdt_strlist(value, len, "ns16550");
+    n->plic = fdt_strlist(value, len, "riscv,plic0") ||
+              fdt_strlist(value, len, "sifive,plic-1.0.0");
+    n->clint = fdt_strlist(value, len, "riscv,clint0") ||
+               fdt_strlist(value, len, "sifive,clint0");
+    n->virtio = fdt_strlist(value, len, "virtio,mmio");
+  } else if (n->chosen && (len == 4 || len == 8)) {
+    if (streq(name, "linux,initrd-start"))
+      n->initrd_start = fdt_cells(value, len / 4);
+    else if (streq(name, "linux,initrd-end"))
+      n->initrd_end = fdt_cells(value, len / 4);
+  }
+}
+
+static void end(void *ctx, int depth) {
+  struct state *s = ctx;
+  struct node *n = &s->nodes[depth];
+
+  if (n->timebase)
+    board.timebase_hz = n->timebase;
+
+  if (n->chosen && n->initrd_end > n->initrd_start) {
+    board.initrd.begin = n->initrd_start;
+    board.initrd.end = n->initrd_end;
+    s->initrd = 1;
+  }
+
+  if (n->disabled)
+    return;
+
+  if (n->cpu && s->harts < MAX_HARTS)
+    s->harts++;
+
+  if (n->memory) {
+    for (size_t i = 0; i < n->nreg && s->nmemory < BOARD_MAX_MEMORY; i += 2) {
+      uint64_t begin = n->reg[i], end = n->reg[i] + n->reg[i + 1];
+      // ram up to the end of the address space ends a page early
+      if (begin > UINTPTR_MAX)
+        continue;
+      if (end > UINTPTR_MAX)
+        end = UINTPTR_MAX & ~0xfff;
+      board.memory[s->nmemory].begin = begin;
+      board.memory[s->nmemory].end = end;
+      s->nmemory++;
+    }
+  }
+
+  if (!n->nreg)
+    return;
+
+  if (n->uart) {
+    board.uart.base = n->reg[0];
+    board.uart.irq = n->irq;
+  } else if (n->clint) {
+    board.clint.base = n->reg[0];
+  } else if (n->plic) {
+    board.plic = n->reg[0];
+    board.plic_size = n->reg[1];
+    board.plic_sources = n->ndev;
+  } else if (n->virtio && s->nvirtio < BOARD_MAX_VIRTIO) {
+    board.virtio[s->nvirtio].base = n->reg[0];
+    board.virtio[s->nvirtio].irq = n->irq;
+    s->nvirtio++;
+  }
+}
+
+int board_init() {
+  static struct state s;
+  struct fdt_walker w = {begin, prop, end, &s};
+
+  board.fdt_size = board.fdt ? fdt_size((const void *)board.fdt) : 0;
+  if (!board.fdt_size || !fdt_walk((const void *)board.fdt, &w)) {
+    board.fdt = 0;
+    board.fdt_size = 0;
+    return 0;
+  }
+
+  // keep the defaults for what the tree did not mention
+  if (s.harts)
+    board.harts = s.harts;
+  if (s.nmemory)
+    board.nmemory = s.nmemory;
+  if (s.nvirtio)
+    board.nvirtio = s.nvirtio;
+  // the firmware tells about every initrd it loaded
+  if (!s.initrd)
+    board.initrd = (struct board_range){0, 0};
+
+  return 1;
+}
+
+struct board_range board_ram() {
+  for (size_t i = 0; i < board.nmemory; i++)
+    if ((uintptr_t)_start >= board.memory[i].begin &&
+        (uintptr_t)_start < board.memory[i].end)
+      return board.memory[i];
+  return board.memory[0];
+}
+
+static void range(const char *name, uintptr_t begin, uintptr_t end) {
+  print("  ");
+  print(name);
+  print(" 0x");
+  print_num(16, begin);
+  print(" - 0x");
+  print_num(16, end);
+  print("\n");
+}
+
+void board_report() {
+  print(board.fdt ? "board: from the device tree\n"
+                  : "board: built-in defaults\n");
+  for (size_t i = 0; i < board.nmemory; i++)
+    range("memory", board.memory[i].begin, board.memory[i].end);
+  if (board.initrd.end)
+    range("initrd", board.initrd.begin, board.initrd.end);
+  if (board.fdt)
+    range("fdt", board.fdt, board.fdt + board.fdt_size);
+  print("  harts ");
+  print_num(10, board.harts);
+  print(", timebase hz ");
+  print_num(10, board.timebase_hz);
+  print("\n  uart 0x");
+  print_num(16, board.uart.base);
+  print(", irq ");
+  print_num(10, board.uart.irq);
+  print("\n  plic 0x");
+  print_num(16, board.plic);
+  print(", sources ");
+  print_num(10, board.plic_sources);
+  print("\n  clint 0x");
+  print_num(16, board.clint.base);
+  print("\n  virtio-mmio slots ");
+  print_num(10, board.nvirtio);
+  print("\n");
+}
@@ -0,0 +1,61 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// the machine the kernel runs on. it starts out with the values of the board
+// selected in config.h, so the uart works from the first instruction on, and
+// is updated from the device tree, once board_init parsed it.
+
+#define BOARD_MAX_MEMORY (4)
+#define BOARD_MAX_VIRTIO (8)
+
+struct board_range {
+  uintptr_t begin, end;
+};
+
+struct board_device {
+  uintptr_t base;
+  uint32_t irq;
+};
+
+struct board {
+  // handed over by the firmware in a1, 0 if there is none
+  uintptr_t fdt;
+  size_t fdt_size;
+
+  struct board_range memory[BOARD_MAX_MEMORY];
+  size_t nmemory;
+
+  // cpu nodes, at most MAX_HARTS
+  size_t harts;
+  uint32_t timebase_hz;
+
+  struct board_device uart;
+  struct board_device clint;
+
+  uintptr_t plic;
+  size_t plic_size;
+  uint32_t plic_sources;
+
+  struct board_device virtio[BOARD_MAX_VIRTIO];
+  size_t nvirtio;
+
+  // begin is 0, if there is none. end is 0, if it is unknown
+  struct board_range initrd;
+};
+
+extern struct board board;
+
+// parse the device tree at board.fdt. returns 0, if there is none, then the
+// defaults stay in place. called once, by the boot hart
+int board_init();
+
+// the memory range, which holds the kernel
+struct board_range board_ram();
+
+// what was found, and where
+void board_report();
+
+#endif
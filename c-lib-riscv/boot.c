@@ -0,0 +1,40 @@
+#include "boot.h"
+#include "console.h"
+#include "riscv.h"
+
+static const char *phase_names[] = {
+    [BOOT_CRT0] = "crt0",
+    [BOOT_MACHINE] = "machine",
+    [BOOT_MRET] = "mret",
+    [BOOT_SUPERVISOR] = "supervisor",
+    [BOOT_PAGES] = "pages",
+    [BOOT_DRIVERS] = "drivers",
+    [BOOT_READY] = "ready",
+};
+
+static uint64_t times[BOOT_NUM_PHASES];
+
+void boot_mark(enum boot_phase phase) { times[phase] = rdtime(); }
+
+void boot_mark_at(enum boot_phase phase, uint64_t time) {
+  times[phase] = time;
+}
+
+static inline size_t usec(uint64_t ticks) {
+  return ticks / (TIMEBASE_HZ / 1000000);
+}
+
+void boot_report() {
+  print("boot: phase, start us, duration us\n");
+
+  for (int i = 0; i < BOOT_NUM_PHASES; i++) {
+    print("  ");
+    print(phase_names[i]);
+    print(", ");
+    print_num(10, usec(times[i] - times[BOOT_CRT0]));
+    print(", ");
+    if (i + 1 < BOOT_NUM_PHASES)
+      print_num(10, usec(times[i + 1] - times[i]));
+    print("\n");
+  }
+}
@@ -0,0 +1,30 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// the hart which won the race in crt0. it zeroed bss and does the global
+// setup, the others only set up themselves
+extern size_t boot_hart;
+
+// the phases the boot hart passes, until the kernel is ready. the start of
+// each is recorded, so time to ready can be tracked as the kernel grows
+enum boot_phase {
+  BOOT_CRT0,       // first instruction in crt0
+  BOOT_MACHINE,    // machine mode setup
+  BOOT_MRET,       // drop to supervisor mode
+  BOOT_SUPERVISOR, // supervisor mode setup
+  BOOT_PAGES,      // page pool zeroing
+  BOOT_DRIVERS,    // driver init
+  BOOT_READY,      // waiting for interrupts
+  BOOT_NUM_PHASES,
+};
+
+void boot_mark(enum boot_phase phase);
+void boot_mark_at(enum boot_phase phase, uint64_t time);
+
+// print the phases with their start and duration, in microseconds
+void boot_report();
+
+#endif
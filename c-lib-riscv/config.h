@@ -1 +1,20 @@
 #define BOARD_QEMU_RISCV_VIRT
+
+// the linker script reserves a 16K slot for this many harts. the lowest page
+// of a slot is the guard page, the stack takes the rest, see stack.h
+#define MAX_HARTS (8)
+#define STACK_SLOT_SHIFT (14)
+#define STACK_SLOT (1 << STACK_SLOT_SHIFT)
+#define STACK_GUARD (0x1000)
+#define STACK_SIZE (STACK_SLOT - STACK_GUARD)
+
+// crt0 paints the slots with this, to find the high-water marks
+#define STACK_CANARY (0x57ac57ac)
+
+// zero pages when they are allocated, instead of zeroing the whole pool with
+// all harts at boot. this trades boot time against allocation latency
+// #define PAGE_ZERO_LAZY
+
+// send console output to the virtio console, once it is found. the uart
+// stays in use for input, and for output until then
+// #define CONSOLE_PREFER_VIRTIO
@@ -0,0 +1,109 @@
+#include "console.h"
+#include "page.h"
+#include "uart.h"
+#include "virtio_console.h"
+
+static enum console_backend backend = CONSOLE_UART;
+
+enum console_backend console_select(enum console_backend b) {
+  if (b == CONSOLE_VIRTIO && !vcon_present())
+    b = CONSOLE_UART;
+
+  backend = b;
+  return b;
+}
+
+enum console_backend console_backend() { return backend; }
+
+static void uart_puts(const char *s, size_t n) {
+  for (size_t i = 0; i < n; i++)
+    uart_write(s[i]);
+}
+
+void console_write(const char *s, size_t n) {
+  if (backend == CONSOLE_VIRTIO)
+    vcon_write(s, n);
+  else
+    uart_puts(s, n);
+}
+
+void console_puts(const char *s) {
+  size_t n = 0;
+  while (s[n])
+    n++;
+  console_write(s, n);
+}
+
+#define BENCH_BYTES (4 << 20)
+#define BENCH_BATCH (16)
+
+// a page of log lines, dumped over and over
+static void bench_fill(char *page) {
+  static const char line[] = "log: the quick brown fox jumps over the dog ";
+  size_t n = 0, nr = 0;
+
+  while (n + sizeof(line) + 8 < PAGE_SIZE) {
+    for (size_t i = 0; i < sizeof(line) - 1; i++)
+      page[n++] = line[i];
+
+    char buf[36];
+    for (const char *p = itoa(10, nr++, buf); *p; p++)
+      page[n++] = *p;
+    page[n++] = '\n';
+  }
+
+  while (n < PAGE_SIZE)
+    page[n++] = '\n';
+}
+
+static uint64_t bench_uart(const char *page) {
+  uint64_t start = rdtime();
+  for (size_t n = 0; n < BENCH_BYTES; n += PAGE_SIZE)
+    uart_puts(page, PAGE_SIZE);
+  return rdtime() - start;
+}
+
+// the same page is queued several times per notification, without copying
+static uint64_t bench_virtio(char *page) {
+  struct virtq_buf bufs[BENCH_BATCH];
+  for (size_t i = 0; i < BENCH_BATCH; i++)
+    bufs[i] = (struct virtq_buf){page, PAGE_SIZE};
+
+  uint64_t start = rdtime();
+  for (size_t n = 0; n < BENCH_BYTES; n += BENCH_BATCH * PAGE_SIZE)
+    vcon_writev(bufs, BENCH_BATCH);
+  return rdtime() - start;
+}
+
+static void bench_report(const char *name, uint64_t ticks) {
+  if (!ticks)
+    ticks = 1;
+
+  print("  ");
+  print(name);
+  print(", ms ");
+  print_num(10, ticks * 1000 / TIMEBASE_HZ);
+  print(", KB/s ");
+  print_num(10, (uint64_t)BENCH_BYTES / 1024 * TIMEBASE_HZ / ticks);
+  print("\n");
+}
+
+void console_bench() {
+  char *page = page_alloc();
+  if (!page)
+    return;
+
+  bench_fill(page);
+
+  uint64_t uart = bench_uart(page);
+  uint64_t virtio = vcon_present() ? bench_virtio(page) : 0;
+
+  print("console: backend, time, throughput for a 4 MB log\n");
+  bench_report("uart", uart);
+  if (vcon_present())
+    bench_report("virtio", virtio);
+  else
+    print("  virtio, no device\n");
+
+  page_free(page);
+}
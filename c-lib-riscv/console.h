@@ -0,0 +1,35 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include "fmt.h"
+#include "riscv.h"
+#include <stddef.h>
+
+// output goes either to the uart or, once it is probed, to the virtio
+// console. the uart stays the fallback, it works from the first instruction
+// on and from machine mode. input always comes from the uart.
+enum console_backend {
+  CONSOLE_UART,
+  CONSOLE_VIRTIO,
+};
+
+// select the backend for output. returns the one in effect, the virtio
+// console may be missing
+enum console_backend console_select(enum console_backend b);
+enum console_backend console_backend();
+
+void console_write(const char *s, size_t n);
+void console_puts(const char *s);
+
+// dump a multi megabyte log through both backends and compare throughput
+void console_bench();
+
+#define print(s) console_puts(s)
+
+#define print_num(base, num)                                                   \
+  do {                                                                         \
+    char _buf[36];                                                             \
+    print(itoa(base, num, _buf));                                              \
+  } while (0)
+
+#endif
@@ -0,0 +1,85 @@
+#include "elf.h"
+
+#if __riscv_xlen == 64
+#define ELFCLASS_NATIVE ELFCLASS64
+#else
+#define ELFCLASS_NATIVE ELFCLASS32
+#endif
+
+// the fields of either class, that the loader needs
+struct segment {
+  uint64_t offset, vaddr, filesz, memsz;
+  uint32_t type, flags;
+};
+
+static int segment(const uint8_t *image, size_t size, size_t i,
+                   struct segment *s) {
+  if (image[EI_CLASS] == ELFCLASS32) {
+    const struct elf32_ehdr *eh = (const void *)image;
+    uint64_t off = eh->e_phoff + (uint64_t)i * eh->e_phentsize;
+    if (eh->e_phentsize < sizeof(struct elf32_phdr) ||
+        off + sizeof(struct elf32_phdr) > size)
+      return 0;
+
+    const struct elf32_phdr *ph = (const void *)(image + off);
+    *s = (struct segment){ph->p_offset, ph->p_vaddr, ph->p_filesz,
+                          ph->p_memsz, ph->p_type, ph->p_flags};
+  } else {
+    const struct elf64_ehdr *eh = (const void *)image;
+    uint64_t off = eh->e_phoff + (uint64_t)i * eh->e_phentsize;
+    if (eh->e_phentsize < sizeof(struct elf64_phdr) ||
+        off + sizeof(struct elf64_phdr) > size)
+      return 0;
+
+    const struct elf64_phdr *ph = (const void *)(image + off);
+    *s = (struct segment){ph->p_offset, ph->p_vaddr, ph->p_filesz,
+                          ph->p_memsz, ph->p_type, ph->p_flags};
+  }
+  return 1;
+}
+
+int elf_load(const void *image, size_t size, struct vm *vm,
+             uintptr_t *entry) {
+  const uint8_t *p = image;
+  const struct elf32_ehdr *eh32 = image;
+  const struct elf64_ehdr *eh64 = image;
+
+  if (size < sizeof(struct elf64_ehdr) || p[0] != 0x7f || p[1] != 'E' ||
+      p[2] != 'L' || p[3] != 'F' || p[EI_DATA] != ELFDATA2LSB)
+    return 0;
+
+  // the headers agree up to e_version
+  if (p[EI_CLASS] != ELFCLASS_NATIVE || eh32->e_type != ET_EXEC ||
+      eh32->e_machine != EM_RISCV)
+    return 0;
+
+  size_t phnum = p[EI_CLASS] == ELFCLASS32 ? eh32->e_phnum : eh64->e_phnum;
+  uint64_t e_entry = p[EI_CLASS] == ELFCLASS32 ? eh32->e_entry : eh64->e_entry;
+
+  for (size_t i = 0; i < phnum; i++) {
+    struct segment s;
+    if (!segment(p, size, i, &s))
+      return 0;
+
+    if (s.type != PT_LOAD || !s.memsz)
+      continue;
+
+    // the file offset and the address must agree within a page, or the
+    // file could not be mapped in place
+    if (s.filesz > s.memsz || s.offset + s.filesz > size ||
+        (s.offset & (PAGE_SIZE - 1)) != (s.vaddr & (PAGE_SIZE - 1)) ||
+        s.vaddr + s.memsz > USER_STACK_TOP - USER_STACK_SIZE)
+      return 0;
+
+    uint32_t prot = (s.flags & PF_R ? PTE_R : 0) |
+                    (s.flags & PF_W ? PTE_W : 0) |
+                    (s.flags & PF_X ? PTE_X : 0);
+
+    if (!vm_map(vm, s.vaddr, s.vaddr + s.memsz, prot, p + s.offset,
+                s.filesz))
+      return 0;
+  }
+
+  *entry = e_entry;
+  return 1;
+}
@@ -0,0 +1,90 @@
+#ifndef ELF_H
+#define ELF_H
+
+#include "vm.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Tool Interface Standard (TIS) Executable and Linking Format (ELF)
+// Specification, and the 64 bit extension. both classes are parsed, but only
+// the native one, ELF32 on rv32, can be run.
+
+#define EI_NIDENT (16)
+#define EI_CLASS (4)
+#define EI_DATA (5)
+
+#define ELFCLASS32 (1)
+#define ELFCLASS64 (2)
+#define ELFDATA2LSB (1)
+
+#define ET_EXEC (2)
+#define EM_RISCV (243)
+
+#define PT_LOAD (1)
+
+#define PF_X (1)
+#define PF_W (2)
+#define PF_R (4)
+
+struct elf32_ehdr {
+  uint8_t e_ident[EI_NIDENT];
+  uint16_t e_type;
+  uint16_t e_machine;
+  uint32_t e_version;
+  uint32_t e_entry;
+  uint32_t e_phoff;
+  uint32_t e_shoff;
+  uint32_t e_flags;
+  uint16_t e_ehsize;
+  uint16_t e_phentsize;
+  uint16_t e_phnum;
+  uint16_t e_shentsize;
+  uint16_t e_shnum;
+  uint16_t e_shstrndx;
+};
+
+struct elf32_phdr {
+  uint32_t p_type;
+  uint32_t p_offset;
+  uint32_t p_vaddr;
+  uint32_t p_paddr;
+  uint32_t p_filesz;
+  uint32_t p_memsz;
+  uint32_t p_flags;
+  uint32_t p_align;
+};
+
+struct elf64_ehdr {
+  uint8_t e_ident[EI_NIDENT];
+  uint16_t e_type;
+  uint16_t e_machine;
+  uint32_t e_version;
+  uint64_t e_entry;
+  uint64_t e_phoff;
+  uint64_t e_shoff;
+  uint32_t e_flags;
+  uint16_t e_ehsize;
+  uint16_t e_phentsize;
+  uint16_t e_phnum;
+  uint16_t e_shentsize;
+  uint16_t e_shnum;
+  uint16_t e_shstrndx;
+};
+
+struct elf64_phdr {
+  uint32_t p_type;
+  uint32_t p_flags;
+  uint64_t p_offset;
+  uint64_t p_vaddr;
+  uint64_t p_paddr;
+  uint64_t p_filesz;
+  uint64_t p_memsz;
+  uint64_t p_align;
+};
+
+// add a region for every loadable segment of the image. no page is touched,
+// the segments are paged in by vm_fault. returns 0, if the image is not a
+// static riscv executable of the native class, or a segment does not fit
+int elf_load(const void *image, size_t size, struct vm *vm, uintptr_t *entry);
+
+#endif
@@ -0,0 +1,112 @@
+#include "fdt.h"
+
+// 5.2 Header
+struct fdt_header {
+  uint32_t magic;
+  uint32_t totalsize;
+  uint32_t off_dt_struct;
+  uint32_t off_dt_strings;
+  uint32_t off_mem_rsvmap;
+  uint32_t version;
+  uint32_t last_comp_version;
+  uint32_t boot_cpuid_phys;
+  uint32_t size_dt_strings;
+  uint32_t size_dt_struct;
+};
+
+// 5.4.1 Lexical structure
+#define FDT_BEGIN_NODE (1)
+#define FDT_END_NODE (2)
+#define FDT_PROP (3)
+#define FDT_NOP (4)
+#define FDT_END (9)
+
+#define HEADER(fdt, field)                                                     \
+  fdt32((const uint8_t *)(fdt) + offsetof(struct fdt_header, field))
+
+size_t fdt_size(const void *fdt) {
+  if (HEADER(fdt, magic) != FDT_MAGIC || HEADER(fdt, last_comp_version) > 17)
+    return 0;
+  return HEADER(fdt, totalsize);
+}
+
+static inline uint32_t align4(uint32_t n) { return (n + 3) & ~3; }
+
+int fdt_walk(const void *fdt, const struct fdt_walker *w) {
+  if (!fdt_size(fdt))
+    return 0;
+
+  const uint8_t *base = fdt;
+  const uint8_t *p = base + HEADER(fdt, off_dt_struct);
+  const uint8_t *end = p + HEADER(fdt, size_dt_struct);
+  const char *strings = (const char *)base + HEADER(fdt, off_dt_strings);
+  int depth = -1;
+
+  while (p + 4 <= end) {
+    uint32_t token = fdt32(p);
+    p += 4;
+
+    switch (token) {
+    case FDT_BEGIN_NODE: {
+      const char *name = (const char *)p;
+      uint32_t n = 0;
+      while (p + n < end && name[n])
+        n++;
+      p += align4(n + 1);
+
+      depth++;
+      if (depth < FDT_MAX_DEPTH && w->begin)
+        w->begin(w->ctx, depth, name);
+      break;
+    }
+    case FDT_END_NODE:
+      if (depth < 0)
+        return 0;
+      if (depth < FDT_MAX_DEPTH && w->end)
+        w->end(w->ctx, depth);
+      depth--;
+      break;
+    case FDT_PROP: {
+      if (p + 8 > end)
+        return 0;
+      uint32_t len = fdt32(p);
+      uint32_t nameoff = fdt32(p + 4);
+      p += 8;
+      if (p + len > end)
+        return 0;
+
+      if (depth >= 0 && depth < FDT_MAX_DEPTH && w->prop)
+        w->prop(w->ctx, depth, strings + nameoff, p, len);
+      p += align4(len);
+      break;
+    }
+    case FDT_NOP:
+      break;
+    case FDT_END:
+      return depth == -1;
+    default:
+      return 0;
+    }
+  }
+
+  return 0;
+}
+
+int fdt_strlist(const void *value, uint32_t len, const char *s) {
+  const char *list = value;
+
+  for (uint32_t i = 0; i < len;) {
+    uint32_t n = 0;
+    while (i + n < len && list[i + n] && s[n] == list[i + n])
+      n++;
+    if (i + n < len && !list[i + n] && !s[n])
+      return 1;
+
+    // skip to the next string
+    while (i < len && list[i])
+      i++;
+    i++;
+  }
+
+  return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef FDT_H
+#define FDT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Devicetree Specification v0.4, 5 Flattened Devicetree (DTB) Format.
+//
+// the blob is walked once, front to back, without building a tree. the
+// callbacks see the nodes and their properties in the order of the blob,
+// properties of a node come before its children. values point into the blob
+// and are big endian.
+
+#define FDT_MAGIC (0xd00dfeed)
+
+// nodes nested deeper than this are skipped
+#define FDT_MAX_DEPTH (8)
+
+struct fdt_walker {
+  void (*begin)(void *ctx, int depth, const char *name);
+  void (*prop)(void *ctx, int depth, const char *name, const void *value,
+               uint32_t len);
+  void (*end)(void *ctx, int depth);
+  void *ctx;
+};
+
+// the total size of the blob, or 0, if it is not a valid blob
+size_t fdt_size(const void *fdt);
+
+// returns 0, if the blob is malformed. the callbacks may have seen part of it
+int fdt_walk(const void *fdt, const struct fdt_walker *w);
+
+static inline uint32_t fdt32(const void *p) {
+  const uint8_t *b = p;
+  return (uint32_t)b[0] << 24 | (uint32_t)b[1] << 16 | (uint32_t)b[2] << 8 |
+         b[3];
+}
+
+// a value of 1 or 2 cells
+static inline uint64_t fdt_cells(const void *p, int cells) {
+  const uint8_t *b = p;
+  return cells == 2 ? (uint64_t)fdt32(b) << 32 | fdt32(b + 4) : fdt32(b);
+}
+
+// true, if the string list, like a compatible property, contains s
+int fdt_strlist(const void *value, uint32_t len, const char *s);
+
+#endif
@@ -0,0 +1,126 @@
+#include "fpu.h"
+#include "config.h"
+#include "riscv.h"
+
+// the state of the thread running on each hart
+static struct fpu_state *current[MAX_HARTS];
+
+// the state whose values are held in the registers of each hart. this may be
+// a thread that isnt running anymore. if it comes back to the same hart,
+// before another thread used the fpu, the restore is skipped
+static struct fpu_state *loaded[MAX_HARTS];
+
+// used to wipe the registers, when a thread touches the fpu the first time
+static const struct fpu_state zero;
+
+static inline size_t fs() {
+  size_t status;
+  csrr(status, sstatus);
+  return status & XSTATUS_FS_MASK;
+}
+
+static inline void fs_set(size_t state) {
+  csrc(sstatus, XSTATUS_FS_MASK);
+  if (state)
+    csrs(sstatus, state);
+}
+
+// opcodes of the f and d extensions, see chapter 24 RV32/64G Instruction Set
+// Listings. fp csr accesses are system instructions with fflags(1), frm(2)
+// or fcsr(3) as csr
+static int is_fp(size_t insn) {
+  if ((insn & 3) != 3) {
+    // compressed loads and stores. c.fld, c.fsd, c.fldsp, c.fsdsp and, on
+    // rv32, c.flw, c.fsw, c.flwsp, c.fswsp
+    size_t quadrant = insn & 3;
+    size_t funct3 = (insn >> 13) & 7;
+    if (quadrant == 1)
+      return 0;
+    return funct3 == 1 || funct3 == 3 || funct3 == 5 || funct3 == 7;
+  }
+
+  switch (insn & 0x7f) {
+  case 0x07: // LOAD-FP
+  case 0x27: // STORE-FP
+  case 0x43: // MADD
+  case 0x47: // MSUB
+  case 0x4b: // NMSUB
+  case 0x4f: // NMADD
+  case 0x53: // OP-FP
+    return 1;
+  case 0x73: { // SYSTEM
+    size_t csr = insn >> 20;
+    return ((insn >> 12) & 7) != 0 && csr >= 1 && csr <= 3;
+  }
+  }
+
+  return 0;
+}
+
+void fpu_init() {
+  size_t h = hartid();
+  current[h] = NULL;
+  loaded[h] = NULL;
+  fs_set(XSTATUS_FS_OFF);
+}
+
+void fpu_thread_start(struct fpu_state *s) {
+  s->used = 0;
+  s->hart = MAX_HARTS;
+  current[hartid()] = s;
+  fs_set(XSTATUS_FS_OFF);
+}
+
+void fpu_switch(struct fpu_state *prev, struct fpu_state *next) {
+  size_t h = hartid();
+
+  // only dirty banks need to be written back. clean means the registers
+  // still match what has been saved or restored last time
+  if (prev && fs() == XSTATUS_FS_DIRTY)
+    fpu_save(prev);
+
+  current[h] = next;
+  fs_set(XSTATUS_FS_OFF);
+}
+
+int fpu_trap(size_t insn, size_t epc) {
+  size_t h = hartid();
+  struct fpu_state *s = current[h];
+
+  // the fpu was on, so this is a genuine illegal instruction. the kernel
+  // itself has no fp state and must never use the fpu
+  if (fs() != XSTATUS_FS_OFF || !s)
+    return 0;
+
+  // not every implementation reports the instruction bits in xtval. in that
+  // case read it from the faulting pc, as 2 halfwords, since it may only be
+  // 2 byte aligned
+  if (!insn) {
+    const uint16_t *pc = (const uint16_t *)epc;
+    insn = pc[0];
+    if ((insn & 3) == 3)
+      insn |= (size_t)pc[1] << 16;
+  }
+
+  if (!is_fp(insn))
+    return 0;
+
+  // the registers can only be accessed, while the fpu is on
+  fs_set(XSTATUS_FS_INITIAL);
+
+  if (!s->used) {
+    // start from the initial state and dont leak the previous owners values
+    fpu_restore(&zero);
+    s->used = 1;
+  } else if (loaded[h] != s || s->hart != h) {
+    fpu_restore(s);
+  }
+
+  s->hart = h;
+  loaded[h] = s;
+
+  // the registers match the saved state. the hardware sets it to dirty,
+  // once the thread writes to any of them
+  fs_set(XSTATUS_FS_CLEAN);
+  return 1;
+}
@@ -0,0 +1,43 @@
+#ifndef FPU_H
+#define FPU_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// floating point state of a thread. with the d extension the registers are 64
+// bit wide, even on rv32.
+//
+// the state is handled lazily. a thread starts with FS=Off, so its first fp
+// instruction traps. only then the bank is loaded and the fpu is enabled. on
+// a switch, the bank is only saved if the hardware marked it as dirty. threads
+// that never use the fpu, and the trap handlers, never pay for it.
+struct fpu_state {
+  uint64_t f[32];
+  uint32_t fcsr;
+  // set once the thread executed its first fp instruction
+  uint32_t used;
+  // hart whose registers hold the bank, if any
+  uint32_t hart;
+};
+
+// implemented in fpu.S
+void fpu_save(struct fpu_state *s);
+void fpu_restore(const struct fpu_state *s);
+
+// disable the fpu for the calling hart
+void fpu_init();
+
+// prepare the state of a new thread and make it current. proc_exec starts
+// every process with it
+void fpu_thread_start(struct fpu_state *s);
+
+// save the bank of prev, if dirty, and make next current. next is NULL, when
+// the hart goes back to the kernel, which has no fp state. the fpu is off
+// afterwards, either way
+void fpu_switch(struct fpu_state *prev, struct fpu_state *next);
+
+// handle an illegal instruction exception. returns 1, if the instruction was
+// an fp instruction, which trapped only because the fpu was off
+int fpu_trap(size_t insn, size_t epc);
+
+#endif
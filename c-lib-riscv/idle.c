@@ -0,0 +1,133 @@
+#include "idle.h"
+#include "config.h"
+#include "console.h"
+#include "rcu.h"
+#include "riscv.h"
+#include "softirq.h"
+
+// the counters are only written by their hart, except for the arrival
+// times. an arrival may race with the hart clearing pending, then its wake
+// up is not counted
+struct idle_stats {
+  uint64_t last;
+  int64_t avg;
+  // arrival of the first work since the hart went idle, 0 if none
+  uint64_t pending;
+
+  uint64_t poll_hits;
+  uint64_t poll_ticks;
+  uint64_t poll_wake_ticks;
+  uint64_t wfi_wakes;
+  uint64_t wfi_wake_ticks;
+  uint64_t spurious;
+  uint64_t max_wake_ticks;
+};
+
+static struct idle_stats stats[MAX_HARTS];
+
+void idle_arrival(size_t hart) {
+  struct idle_stats *s = &stats[hart];
+  uint64_t now = rdtime();
+
+  // without a history, start out not polling
+  if (!s->last)
+    s->avg = IDLE_POLL_MAX_NS / (1000000000 / TIMEBASE_HZ) + 1;
+  else
+    s->avg += ((int64_t)(now - s->last) - s->avg) >> IDLE_AVG_SHIFT;
+  s->last = now;
+
+  if (!s->pending)
+    s->pending = now;
+}
+
+static uint64_t window(struct idle_stats *s) {
+  int64_t max = IDLE_POLL_MAX_NS / (1000000000 / TIMEBASE_HZ);
+
+  if (s->avg > max)
+    return 0;
+  return 2 * s->avg < max ? 2 * s->avg : max;
+}
+
+static void woke(struct idle_stats *s, uint64_t *sum) {
+  if (!s->pending)
+    return;
+
+  uint64_t ticks = rdtime() - s->pending;
+  *sum += ticks;
+  if (ticks > s->max_wake_ticks)
+    s->max_wake_ticks = ticks;
+}
+
+void idle() {
+  struct idle_stats *s = &stats[hartid()];
+
+  rcu_quiescent();
+
+  // work that came in while the hart was busy does not count
+  s->pending = 0;
+  if (work_pending())
+    return;
+
+  uint64_t start = rdtime();
+  uint64_t end = start + window(s);
+  uint64_t now = start;
+  while (now < end) {
+    if (work_pending()) {
+      s->poll_hits++;
+      s->poll_ticks += rdtime() - start;
+      woke(s, &s->poll_wake_ticks);
+      return;
+    }
+    rcu_quiescent();
+    now = rdtime();
+  }
+  s->poll_ticks += now - start;
+
+  // interrupts are disabled around the check, so work queued by an interrupt
+  // just before wfi is not missed. wfi wakes up on a pending interrupt, even
+  // if it is disabled. it is taken once they are enabled again
+  csrc(sstatus, XSTATUS_SIE);
+  if (!work_pending()) {
+    rcu_idle_enter();
+    wfi;
+    rcu_idle_exit();
+  }
+  csrs(sstatus, XSTATUS_SIE);
+
+  if (!work_pending()) {
+    s->spurious++;
+    return;
+  }
+  s->wfi_wakes++;
+  woke(s, &s->wfi_wake_ticks);
+}
+
+static void print_ns(uint64_t ticks, uint64_t n) {
+  print(", ");
+  print_num(10, n ? ticks * (1000000000 / TIMEBASE_HZ) / n : 0);
+}
+
+void idle_report() {
+  print("idle: hart, poll hits, wfi wakes, no work, poll us, wake ns poll, "
+        "wake ns wfi, max wake ns, gap ns\n");
+  for (size_t h = 0; h < board.harts; h++) {
+    struct idle_stats *s = &stats[h];
+    if (!s->last)
+      continue;
+    print("  ");
+    print_num(10, h);
+    print(", ");
+    print_num(10, s->poll_hits);
+    print(", ");
+    print_num(10, s->wfi_wakes);
+    print(", ");
+    print_num(10, s->spurious);
+    print(", ");
+    print_num(10, s->poll_ticks / (TIMEBASE_HZ / 1000000));
+    print_ns(s->poll_wake_ticks, s->poll_hits);
+    print_ns(s->wfi_wake_ticks, s->wfi_wakes);
+    print_ns(s->max_wake_ticks, 1);
+    print_ns(s->avg, 1);
+    print("\n");
+  }
+}
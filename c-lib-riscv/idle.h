@@ -0,0 +1,33 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <stddef.h>
+
+// the idle governor of the worker loop.
+//
+// waking up from wfi takes long, compared to work, which arrives every few
+// microseconds. so an idle hart polls its work queue first, with interrupts
+// enabled, and only waits for an interrupt once the window is over. work
+// queued from another hart does not send an ipi, polling is the only way to
+// see it before the next interrupt.
+//
+// the window follows a moving average of the time between work arrivals on
+// the hart. it is twice the average, at most IDLE_POLL_MAX_NS, and 0, if the
+// average is larger than that. then polling would only burn cycles.
+
+#define IDLE_POLL_MAX_NS (100000)
+
+// weight of a new gap in the moving average, 1 / 2^IDLE_AVG_SHIFT
+#define IDLE_AVG_SHIFT (3)
+
+// called by work_queue, for the hart the work is queued on
+void idle_arrival(size_t hart);
+
+// poll, then wait for an interrupt. returns once the calling hart has work,
+// or after an interrupt, which did not queue any
+void idle();
+
+// wake-up latency and poll time per hart
+void idle_report();
+
+#endif
@@ -0,0 +1,215 @@
+#include "initrd.h"
+#include "console.h"
+
+// the crc variant only adds a checksum. the odc format "070707" shares the
+// first 5 digits, but not the header layout
+#define NEWC_MAGIC "070701"
+#define NEWC_CRC_MAGIC "070702"
+#define NEWC_TRAILER "TRAILER!!!"
+
+#define S_IFMT (0170000)
+#define S_IFREG (0100000)
+
+// the header is ascii, each field is 8 hex digits
+struct newc_header {
+  char magic[6];
+  char ino[8];
+  char mode[8];
+  char uid[8];
+  char gid[8];
+  char nlink[8];
+  char mtime[8];
+  char filesize[8];
+  char devmajor[8];
+  char devminor[8];
+  char rdevmajor[8];
+  char rdevminor[8];
+  char namesize[8];
+  char check[8];
+};
+
+// 16 bytes per file, the path and the data stay in the archive
+struct entry {
+  uint32_t hash;
+  uint32_t name;
+  uint32_t data;
+  uint32_t size;
+};
+
+static uintptr_t base;
+static struct entry files[INITRD_MAX_FILES];
+static size_t nfiles;
+
+static uint32_t hex(const char *s) {
+  uint32_t v = 0;
+  for (size_t i = 0; i < 8; i++) {
+    char c = s[i];
+    v <<= 4;
+    if (c >= '0' && c <= '9')
+      v |= c - '0';
+    else if (c >= 'a' && c <= 'f')
+      v |= c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      v |= c - 'A' + 10;
+  }
+  return v;
+}
+
+static inline size_t align4(size_t n) { return (n + 3) & ~3; }
+
+// fnv-1a
+static uint32_t hash(const char *s, size_t n) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < n; i++)
+    h = (h ^ (uint8_t)s[i]) * 16777619u;
+  return h;
+}
+
+static const char *strip(const char *s, size_t *n) {
+  for (;;) {
+    if (*n >= 1 && s[0] == '/')
+      s++, (*n)--;
+    else if (*n >= 2 && s[0] == '.' && s[1] == '/')
+      s += 2, *n -= 2;
+    else
+      return s;
+  }
+}
+
+static int prefix(const char *a, const char *b, size_t n) {
+  for (size_t i = 0; i < n; i++)
+    if (a[i] != b[i])
+      return 0;
+  return 1;
+}
+
+uintptr_t initrd_init(uintptr_t archive, uintptr_t limit) {
+  uintptr_t p = archive;
+  base = archive;
+  nfiles = 0;
+
+  for (;;) {
+    const struct newc_header *h = (const struct newc_header *)p;
+    if (limit - p < sizeof(*h) || (!prefix(h->magic, NEWC_MAGIC, 6) &&
+                                   !prefix(h->magic, NEWC_CRC_MAGIC, 6)))
+      break;
+
+    uint32_t mode = hex(h->mode);
+    uint32_t size = hex(h->filesize);
+    uint32_t namesize = hex(h->namesize);
+    const char *name = (const char *)(p + sizeof(*h));
+
+    // the sizes are not trusted. a truncated archive, or a corrupt one, must
+    // not take the index past its end
+    if (!namesize || namesize > limit - p - sizeof(*h) ||
+        name[namesize - 1]) {
+      print("initrd: corrupt archive\n");
+      break;
+    }
+    size_t namelen = namesize - 1; // without the terminator
+
+    uintptr_t data = archive + align4(p - archive + sizeof(*h) + namesize);
+    if (data > limit || size > limit - data) {
+      print("initrd: corrupt archive\n");
+      break;
+    }
+    // the padding of the last file may be cut off
+    uintptr_t next = data + align4(size);
+    if (next > limit)
+      next = limit;
+
+    if (namelen == sizeof(NEWC_TRAILER) - 1 &&
+        prefix(name, NEWC_TRAILER, namelen)) {
+      p = next;
+      break;
+    }
+
+    if ((mode & S_IFMT) == S_IFREG) {
+      if (nfiles == INITRD_MAX_FILES) {
+        print("initrd: too many files\n");
+      } else {
+        size_t n = namelen;
+        const char *s = strip(name, &n);
+
+        // insertion sort, by hash. archives are small and parsed once
+        struct entry e = {hash(s, n), s - (const char *)archive,
+                          data - archive, size};
+        size_t i = nfiles++;
+        for (; i && files[i - 1].hash > e.hash; i--)
+          files[i] = files[i - 1];
+        files[i] = e;
+      }
+    }
+
+    p = next;
+  }
+
+  return p;
+}
+
+size_t initrd_count() { return nfiles; }
+
+static void fill(const struct entry *e, struct initrd_file *f) {
+  const char *name = (const char *)(base + e->name);
+  size_t n = 0;
+  while (name[n])
+    n++;
+
+  f->name = name;
+  f->namelen = n;
+  f->data = (const void *)(base + e->data);
+  f->size = e->size;
+}
+
+int initrd_file(size_t nth, struct initrd_file *f) {
+  if (nth >= nfiles)
+    return 0;
+
+  fill(&files[nth], f);
+  return 1;
+}
+
+int initrd_find(const char *path, struct initrd_file *f) {
+  size_t n = 0;
+  while (path[n])
+    n++;
+  path = strip(path, &n);
+
+  uint32_t h = hash(path, n);
+
+  // the first entry with the hash, then compare names among the collisions
+  size_t lo = 0, hi = nfiles;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (files[mid].hash < h)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  for (; lo < nfiles && files[lo].hash == h; lo++) {
+    fill(&files[lo], f);
+    if (f->namelen == n && prefix(f->name, path, n))
+      return 1;
+  }
+
+  return 0;
+}
+
+void initrd_list() {
+  struct initrd_file f;
+
+  if (!nfiles) {
+    print("initrd: empty\n");
+    return;
+  }
+
+  for (size_t i = 0; i < nfiles; i++) {
+    initrd_file(i, &f);
+    print("  ");
+    print(f.name);
+    print(", bytes ");
+    print_num(10, f.size);
+    print("\n");
+  }
+}
@@ -0,0 +1,39 @@
+#ifndef INITRD_H
+#define INITRD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// the initrd is a cpio archive in the "newc" format, as written by
+// `cpio -o -H newc`. it is parsed once at boot, into an index of the
+// regular files, sorted by the hash of their path. the archive stays where
+// it was loaded, lookups return pointers into it and nothing is copied.
+
+#define INITRD_MAX_FILES (256)
+
+struct initrd_file {
+  // terminated, cpio stores the nul after the path. namelen leaves it out
+  const char *name;
+  size_t namelen;
+  const void *data;
+  size_t size;
+};
+
+// index the archive at base, which is not read past limit. returns the end of
+// the archive, which must be kept out of the page pool, or base, if there is
+// no archive. called by the boot hart, before page_init
+uintptr_t initrd_init(uintptr_t base, uintptr_t limit);
+
+size_t initrd_count();
+
+// look up a file by path. a leading "/" or "./" is ignored. returns 0, if
+// there is no such file
+int initrd_find(const char *path, struct initrd_file *f);
+
+// the nth file, in index order
+int initrd_file(size_t nth, struct initrd_file *f);
+
+// list the files and their sizes
+void initrd_list();
+
+#endif
@@ -1,22 +1,82 @@
+#include "board.h"
+#include "boot.h"
 #include "config.h"
-#include "fmt.h"
+#include "console.h"
+#include "fpu.h"
+#include "idle.h"
+#include "initrd.h"
+#include "mcall.h"
+#include "page.h"
+#include "plic.h"
+#include "pmp.h"
+#include "proc.h"
+#include "rcu.h"
 #include "riscv.h"
+#include "shell.h"
+#include "softirq.h"
+#include "stack.h"
+#include "trap.h"
+#include "trapstat.h"
+#include "uart.h"
+#include "vdso.h"
+#include "virtio_blk.h"
+#include "virtio_console.h"
+#include "vm.h"
+#include "waitq.h"
 #include <stdint.h>
 
-// implemented in trap.S
-extern void trap_direct();
+// provided by the linker script
+extern char __PAGES_BEGIN__[];
 
 int main();
-void trap_zero();
-void trap_external();
-void plic_init();
-void uart_init();
+void uart_irq(size_t src);
+void uart_rx(size_t c);
 
-#define print(s)                                                               \
-  for (const char *p = s; *p; p++)                                             \
-    uart_write(*p);
+// the console is bulk work, anything else may preempt it. the source comes
+// from the device tree
+static struct irq_driver uart_driver = {
+    .name = "uart",
+    .priority = 1,
+    .top = uart_irq,
+};
+
+// machine mode only serves ecalls, on a stack of its own
+#define MACHINE_STACK_SIZE (1024)
+static uint8_t machine_stacks[MAX_HARTS][MACHINE_STACK_SIZE]
+    __attribute__((aligned(16)));
+
+size_t machine_trap(size_t a0, size_t a1, size_t a2, size_t n) {
+  struct XCause cause = MCause();
+  wait_machine_enter();
+  if (cause.is_interrupt || cause.code != EXC_ENVIRONMENT_CALL_FROM_S_MODE) {
+    print("trap: machine: ");
+    print(cause.is_interrupt ? irq_names[cause.code]
+                             : exception_names[cause.code]);
+    print("\n");
+    while (1)
+      ;
+  }
+
+  size_t ret = MCALL_ENOSYS;
+  switch (n) {
+  case MCALL_PMP_LOAD:
+    pmp_load((const struct pmp_set *)a0, a1, a2);
+    ret = 0;
+    break;
+  }
+
+  wait_machine_exit();
+  return ret;
+}
+
+void start(uint64_t crt0_time, uintptr_t fdt) {
+  wait_machine_enter();
+  if (hartid() == boot_hart) {
+    board.fdt = fdt;
+    boot_mark_at(BOOT_CRT0, crt0_time);
+    boot_mark(BOOT_MACHINE);
+  }
 
-void start() {
   print("init: machine\n");
 
   // clear all config in satp. this sets the mode to bare, which disables
@@ -33,7 +93,8 @@ void start() {
   csrw(pmpaddr0, ~0);
 
   // set the pmpcfg0 to TOR and allow all access,
-  // but dont lock the config
+  // but dont lock the config. once the board is
+  // known, the kernel narrows it down, see pmp.h
   csrw(pmpcfg0, PMPCFG_A_TOR | PMPCFG_R | PMPCFG_W | PMPCFG_X);
 
   // setup the previous mode and program counter
@@ -48,78 +109,200 @@ void start() {
   csrs(mideleg, ~0);
   csrs(medeleg, ~0);
 
+  // except for ecalls from supervisor mode, those are served here, see mcall.h
+  csrc(medeleg, 1 << EXC_ENVIRONMENT_CALL_FROM_S_MODE);
+  csrw(mtvec, (size_t)trap_machine);
+  csrw(mscratch, (size_t)machine_stacks[hartid() + 1]);
+
+  // allow supervisor mode to read the cycle, time and instret counters
+  csrw(mcounteren, 0x7);
+
+  if (hartid() == boot_hart)
+    boot_mark(BOOT_MRET);
+
+  wait_machine_exit();
+
   // use mret to jump to main with the new priviledge level
   mret;
 }
 
 int main() {
+  size_t boot = hartid() == boot_hart;
+
+  if (boot)
+    boot_mark(BOOT_SUPERVISOR);
+
   print("init: supervisor\n");
 
   csrw(stvec, (size_t)trap_direct);
+
+  // user mode reads the time csr itself, see vdso.h
+  csrw(scounteren, 0x7);
+  fpu_init();
+
+  // the boot hart sets up the page pool, then every hart helps to zero it
+  if (boot) {
+    boot_mark(BOOT_PAGES);
+
+    // the device tree sizes the pool, it is still mapped 1:1 in bare mode
+    board_init();
+    pmp_init();
+
+    // the pool starts past the stacks, the device tree and the initrd may be
+    // anywhere. keep the pool from handing them out
+    if (board.fdt)
+      page_reserve(board.fdt, board.fdt + board.fdt_size);
+    if (board.initrd.begin) {
+      // the archive is indexed in place. without a device tree its size is
+      // unknown, it ends with ram at the latest
+      uintptr_t limit = board.initrd.end ? board.initrd.end : board_ram().end;
+      uintptr_t end = initrd_init(board.initrd.begin, limit);
+      if (end < board.initrd.end)
+        end = board.initrd.end;
+      page_reserve(board.initrd.begin, end);
+    }
+
+    page_init((uintptr_t)__PAGES_BEGIN__, board_ram().end);
+  }
+  page_zero_share();
+  pmp_hart_init();
+  rcu_hart_init();
+  if (boot) {
+    page_zero_wait();
+    vm_init();
+    vdso_init();
+    boot_mark(BOOT_DRIVERS);
+  }
+
   csrs(sie, XIE_SEIE);
   csrs(sstatus, XSTATUS_SIE);
 
-  plic_init();
-  uart_init();
+  plic_hart_init();
+  if (boot) {
+    uart_driver.src = PLIC_SRC_UART;
+    plic_register(&uart_driver);
+
+    // console input is only routed to the boot hart, so lines are put
+    // together in the order they are typed. writers on other harts spin
+    uart_init(hartid());
+
+    if (blk_init(hartid())) {
+      print("init: virtio-blk, sectors ");
+      print_num(10, blk_capacity());
+      print("\n");
+    }
+
+    if (initrd_count()) {
+      print("init: initrd, files ");
+      print_num(10, initrd_count());
+      print("\n");
+    }
+
+    if (vcon_init()) {
+      print("init: virtio-console\n");
+#ifdef CONSOLE_PREFER_VIRTIO
+      console_select(CONSOLE_VIRTIO);
+#endif
+    }
+
+    boot_mark(BOOT_READY);
+    boot_report();
+  }
 
   print("done: waiting for interrupts\n");
-  while (1)
-    wfi;
-}
 
-void trap_zero() {
-  print("trap: ");
+  // the worker, see idle.h for how it waits
+  while (1) {
+    work_run();
+    idle();
+  }
+}
 
+static void trap(struct trap_frame *f) {
   struct XCause cause = SCause();
-  if (cause.is_interrupt) {
-    print("interrupt: ");
-    print(irq_names[cause.code]);
-    print("\n");
+  int user = !(f->sstatus & XSTATUS_SPP);
 
-    trap_external();
+  // user mode holds no references. interrupts count as well, a long process
+  // takes few exceptions
+  if (user)
+    rcu_quiescent();
+
+  if (cause.is_interrupt) {
+    softirq_enter();
+    if (cause.code == IRQ_SUPERVISOR_EXTERNAL_INTERRUPT)
+      plic_trap();
+    softirq_exit();
     return;
   }
 
-  print("exception: ");
-  print(exception_names[cause.code]);
-  print("\n");
+  // threads start with the fpu off. their first fp instruction ends up here
+  if (cause.code == EXC_ILLEGAL_INSTRUCTION) {
+    size_t tval, epc;
+    csrr(tval, stval);
+    csrr(epc, sepc);
+    if (fpu_trap(tval, epc))
+      return;
+  }
 
-  while (1)
-    ;
-}
+  int kill = user;
+  struct proc *p = proc_current();
 
-void trap_external() {
-  size_t ctx = plic_context(hartid(), PLIC_MODE_S);
-  size_t src = *(uint32_t *)plic_warl(PLIC_BASE, PLIC_CLAIM_OFFSET, ctx);
+  // user pages are mapped on demand. the kernel may fault on them as well,
+  // when it accesses user memory. if the fault cannot be resolved, because
+  // the address is not mapped, or memory ran out, the process pays for it,
+  // not the kernel
+  if (p && (cause.code == EXC_INSTRUCTION_PAGE_FAULT ||
+            cause.code == EXC_LOAD_PAGE_FAULT ||
+            cause.code == EXC_STORE_AMO_PAGE_FAULT)) {
+    size_t tval;
+    csrr(tval, stval);
+    if (user || tval < USER_TOP) {
+      if (vm_fault(&p->vm, tval, cause.code))
+        return;
+      kill = 1;
+    }
+  }
 
-  if (src == PLIC_SRC_UART) {
-    // TODO: check uart IIR
-    print("uart: ");
-    uart_write(uart_read());
+  if (kill) {
+    print("proc: killed, ");
+    print(exception_names[cause.code]);
     print("\n");
+    proc_exit(PROC_KILLED);
   }
 
-  // for now, simply compelte any interupt
-  *(uint32_t *)plic_warl(PLIC_BASE, PLIC_COMPLETE_OFFSET, ctx) = src;
+  print("trap: exception: ");
+  print(exception_names[cause.code]);
+  print("\n");
+
+  while (1)
+    ;
 }
 
-void plic_init() {
-  size_t ctx = plic_context(hartid(), 1);
+void trap_zero(struct trap_frame *f) {
+  stack_check();
 
-  *(uint32_t *)plic_array(PLIC_BASE, PLIC_PRIORITY_OFFSET, PLIC_SRC_UART) = 1;
+  // scause is read up front, a nested trap overwrites it
+  size_t cause;
+  csrr(cause, scause);
+  uint32_t start = rdcycle();
 
-  *(uint32_t *)plic_bits(PLIC_BASE, PLIC_ENABLE_OFFSET, ctx, PLIC_SRC_UART) |=
-      1 << (PLIC_SRC_UART % 32);
+  trap(f);
 
-  *(uint32_t *)plic_warl(PLIC_BASE, PLIC_THRESHOLD_OFFSET, ctx) = 0;
+  trapstat_trap(cause, rdcycle() - start);
 }
 
-void uart_init() {
-  *(volatile uint8_t *)(UART_BASE + UART_FCR) |=
-      UART_FCR_ENABLE_FIFO | UART_FCR_CLEAR_RX | UART_FCR_CLEAR_TX |
-      UART_FCR_TRIGGER_8b;
-
-  *(volatile uint8_t *)(UART_BASE + UART_LCR) |= UART_LCR_WORD_LEN_8b;
+// the top half. wake the writers, and drain the fifo, reading rbr clears the
+// interrupt. the rest is left for the bottom half, which runs once interrupts
+// are enabled again
+void uart_irq(size_t src) {
+  uart_tx_irq();
+  while (uart_rx_ready())
+    softirq_raise(uart_rx, uart_read());
+}
 
-  *(volatile uint8_t *)(UART_BASE + UART_IER) |= UART_IER_RX_AVAIL;
+// the bottom half of the uart. echo, and let the worker run the shell, as
+// commands may take a while
+void uart_rx(size_t c) {
+  uart_write(c);
+  work_queue(hartid(), shell_input, c);
 }
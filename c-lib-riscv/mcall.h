@@ -0,0 +1,28 @@
+#ifndef MCALL_H
+#define MCALL_H
+
+#include <stddef.h>
+
+// services of machine mode, for the kernel. start() delegates every trap to
+// supervisor mode, except for ecalls from it. like a system call, the number
+// is passed in a7, the arguments in a0 to a2 and the result comes back in a0.
+// the handler runs on a small stack of its own, in trap_machine
+
+// load entries [a1, a2) of the struct pmp_set at a0, see pmp.h
+#define MCALL_PMP_LOAD (0)
+
+#define MCALL_ENOSYS ((size_t)-1)
+
+// implemented in trap.S
+void trap_machine();
+
+static inline size_t mcall(size_t n, size_t arg0, size_t arg1, size_t arg2) {
+  register size_t a0 asm("a0") = arg0;
+  register size_t a1 asm("a1") = arg1;
+  register size_t a2 asm("a2") = arg2;
+  register size_t a7 asm("a7") = n;
+  asm volatile("ecall" : "+r"(a0) : "r"(a1), "r"(a2), "r"(a7) : "memory");
+  return a0;
+}
+
+#endif
@@ -0,0 +1,143 @@
+#include "mem.h"
+#include <stdint.h>
+
+// words may alias with any other type, just like chars
+typedef size_t __attribute__((may_alias)) word;
+
+#define WSIZE (sizeof(word))
+#define WMASK (WSIZE - 1)
+
+// below this, aligning the pointers costs more than it gains
+#define SHORT (2 * WSIZE)
+
+static inline int aligned(const void *p) { return !((uintptr_t)p & WMASK); }
+
+static void copy_fwd(uint8_t *d, const uint8_t *s, size_t n) {
+  if (n >= SHORT) {
+    while (!aligned(d)) {
+      *d++ = *s++;
+      n--;
+    }
+
+    word *dw = (word *)(void *)d;
+
+    if (aligned(s)) {
+      const word *sw = (const word *)(const void *)s;
+
+      for (; n >= 8 * WSIZE; n -= 8 * WSIZE, dw += 8, sw += 8) {
+        word w0 = sw[0], w1 = sw[1], w2 = sw[2], w3 = sw[3];
+        word w4 = sw[4], w5 = sw[5], w6 = sw[6], w7 = sw[7];
+        dw[0] = w0, dw[1] = w1, dw[2] = w2, dw[3] = w3;
+        dw[4] = w4, dw[5] = w5, dw[6] = w6, dw[7] = w7;
+      }
+
+      for (; n >= WSIZE; n -= WSIZE)
+        *dw++ = *sw++;
+
+      s = (const uint8_t *)sw;
+    } else {
+      // the source is misaligned relative to the destination. load aligned
+      // words and combine the bytes of two neighbours, little endian. reading
+      // the whole word past the last needed byte is fine, an aligned word
+      // never crosses a page
+      size_t off = (uintptr_t)s & WMASK;
+      size_t rshift = off * 8;
+      size_t lshift = WSIZE * 8 - rshift;
+      const word *sw = (const word *)(const void *)(s - off);
+      word lo = *sw++;
+
+      for (; n >= WSIZE; n -= WSIZE, s += WSIZE) {
+        word hi = *sw++;
+        *dw++ = (lo >> rshift) | (hi << lshift);
+        lo = hi;
+      }
+    }
+
+    d = (uint8_t *)dw;
+  }
+
+  while (n--)
+    *d++ = *s++;
+}
+
+static void copy_bwd(uint8_t *d, const uint8_t *s, size_t n) {
+  d += n;
+  s += n;
+
+  // only the mutually aligned case is worth the effort, backwards copies are
+  // rare
+  if (n >= SHORT && !(((uintptr_t)d ^ (uintptr_t)s) & WMASK)) {
+    while (!aligned(d)) {
+      *--d = *--s;
+      n--;
+    }
+
+    word *dw = (word *)(void *)d;
+    const word *sw = (const word *)(const void *)s;
+
+    for (; n >= 4 * WSIZE; n -= 4 * WSIZE) {
+      dw -= 4, sw -= 4;
+      word w0 = sw[0], w1 = sw[1], w2 = sw[2], w3 = sw[3];
+      dw[0] = w0, dw[1] = w1, dw[2] = w2, dw[3] = w3;
+    }
+
+    for (; n >= WSIZE; n -= WSIZE)
+      *--dw = *--sw;
+
+    d = (uint8_t *)dw;
+    s = (const uint8_t *)sw;
+  }
+
+  while (n--)
+    *--d = *--s;
+}
+
+void *memcpy(void *restrict dst, const void *restrict src, size_t n) {
+  copy_fwd(dst, src, n);
+  return dst;
+}
+
+void *memmove(void *dst, const void *src, size_t n) {
+  // copying forward is safe, unless dst starts inside src. the unsigned
+  // difference covers both, dst below src and dst past the end of src
+  if ((uintptr_t)dst - (uintptr_t)src >= n)
+    copy_fwd(dst, src, n);
+  else
+    copy_bwd(dst, src, n);
+  return dst;
+}
+
+void *memset(void *dst, int c, size_t n) {
+  uint8_t *d = dst;
+
+  if (n >= SHORT) {
+    // broadcast the byte to every byte of a word, without a multiply
+    word v = (uint8_t)c;
+    v |= v << 8;
+    v |= v << 16;
+    if (WSIZE > 4)
+      v |= (v << 16) << 16;
+
+    while (!aligned(d)) {
+      *d++ = c;
+      n--;
+    }
+
+    word *dw = (word *)(void *)d;
+
+    for (; n >= 8 * WSIZE; n -= 8 * WSIZE, dw += 8) {
+      dw[0] = v, dw[1] = v, dw[2] = v, dw[3] = v;
+      dw[4] = v, dw[5] = v, dw[6] = v, dw[7] = v;
+    }
+
+    for (; n >= WSIZE; n -= WSIZE)
+      *dw++ = v;
+
+    d = (uint8_t *)dw;
+  }
+
+  while (n--)
+    *d++ = c;
+
+  return dst;
+}
@@ -0,0 +1,16 @@
+#ifndef MEM_H
+#define MEM_H
+
+#include <stddef.h>
+
+// the kernel is built freestanding, but the compiler still emits calls to
+// these for struct copies and large initializers. they copy word wise, in
+// unrolled blocks, once the destination is aligned. a source, which cannot be
+// aligned together with the destination, is read with aligned loads and
+// shifted into place, instead of falling back to a byte loop.
+
+void *memcpy(void *restrict dst, const void *restrict src, size_t n);
+void *memmove(void *dst, const void *src, size_t n);
+void *memset(void *dst, int c, size_t n);
+
+#endif
@@ -0,0 +1,205 @@
+#include "page.h"
+#include "atomic.h"
+#include "config.h"
+#include "mem.h"
+#include "riscv.h"
+#include "spinlock.h"
+
+// pages which have been freed are kept in a list, linked through the pages
+// themselves. pages which have never been handed out are taken from the bump
+// pointer. this way page_init doesnt have to touch every page.
+struct run {
+  struct run *next;
+};
+
+static struct spinlock lock;
+static struct run *freelist;
+static uintptr_t bump;
+static uintptr_t limit;
+static size_t nfree;
+
+// sorted by begin, and page aligned
+static struct {
+  uintptr_t begin, end;
+} reserved[PAGE_MAX_RESERVED];
+static size_t nreserved;
+
+// a count for every page of the pool, kept in front of it
+static volatile uint32_t *refs;
+static uintptr_t pool;
+
+static uintptr_t zero_base;
+static uint32_t zero_chunks;
+static volatile uint32_t zero_next;
+static volatile uint32_t zero_done;
+static volatile uint32_t ready;
+
+void page_reserve(uintptr_t begin, uintptr_t end) {
+  begin &= ~(PAGE_SIZE - 1);
+  end = (end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+  if (nreserved == PAGE_MAX_RESERVED || begin >= end)
+    return;
+
+  size_t i = nreserved++;
+  for (; i && reserved[i - 1].begin > begin; i--)
+    reserved[i] = reserved[i - 1];
+  reserved[i].begin = begin;
+  reserved[i].end = end;
+}
+
+// the bump pointer jumps over reserved ranges
+static uintptr_t skip_reserved(uintptr_t p) {
+  for (size_t i = 0; i < nreserved; i++)
+    if (p >= reserved[i].begin && p < reserved[i].end)
+      p = reserved[i].end;
+  return p;
+}
+
+// zero from..to, except for the reserved ranges
+static void zero(uintptr_t from, uintptr_t to) {
+  for (size_t i = 0; i < nreserved && from < to; i++) {
+    if (reserved[i].end <= from || reserved[i].begin >= to)
+      continue;
+    if (reserved[i].begin > from)
+      memset((void *)from, 0, reserved[i].begin - from);
+    from = reserved[i].end;
+  }
+
+  if (from < to)
+    memset((void *)from, 0, to - from);
+}
+
+void page_init(uintptr_t begin, uintptr_t end) {
+  begin = (begin + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+  end &= ~(PAGE_SIZE - 1);
+
+  // the counts are carved from the start of the pool. they are zeroed with
+  // the pool
+  refs = (volatile uint32_t *)skip_reserved(begin);
+  pool = begin;
+  size_t nrefs = (end - begin) / PAGE_SIZE * sizeof(uint32_t);
+  uintptr_t first =
+      (uintptr_t)refs + ((nrefs + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+#ifdef PAGE_ZERO_LAZY
+  memset((void *)refs, 0, nrefs);
+#endif
+
+  bump = skip_reserved(first);
+  limit = end;
+  nfree = (end - first) / PAGE_SIZE;
+
+  for (size_t i = 0; i < nreserved; i++) {
+    uintptr_t from = reserved[i].begin > first ? reserved[i].begin : first;
+    uintptr_t to = reserved[i].end < end ? reserved[i].end : end;
+    if (from < to)
+      nfree -= (to - from) / PAGE_SIZE;
+  }
+
+  zero_base = begin;
+#ifndef PAGE_ZERO_LAZY
+  zero_chunks = (end - begin + PAGE_ZERO_CHUNK - 1) / PAGE_ZERO_CHUNK;
+#endif
+
+  // the other harts wait for this, before they start to zero
+  store_release(&ready, 1);
+}
+
+void page_zero_share() {
+  while (!load_acquire(&ready))
+    ;
+
+  for (;;) {
+    uint32_t i = amoadd(&zero_next, 1);
+    if (i >= zero_chunks)
+      break;
+
+    uintptr_t from = zero_base + i * PAGE_ZERO_CHUNK;
+    uintptr_t to = from + PAGE_ZERO_CHUNK;
+    if (to > limit)
+      to = limit;
+
+    zero(from, to);
+    amoadd(&zero_done, 1);
+  }
+}
+
+void page_zero_wait() {
+  while (load_acquire(&zero_done) < zero_chunks)
+    ;
+}
+
+void *page_alloc() {
+  void *page = NULL;
+
+  // interrupts and bottom halves may allocate as well
+  size_t sie = irq_save();
+  spin_lock(&lock);
+  if (freelist) {
+    page = freelist;
+    freelist = freelist->next;
+  } else if (bump < limit) {
+    page = (void *)bump;
+    bump = skip_reserved(bump + PAGE_SIZE);
+  }
+  if (page) {
+    nfree--;
+    refs[((uintptr_t)page - pool) / PAGE_SIZE] = 1;
+  }
+  spin_unlock(&lock);
+  irq_restore(sie);
+
+#ifdef PAGE_ZERO_LAZY
+  if (page)
+    memset(page, 0, PAGE_SIZE);
+#else
+  // the pool was zeroed at boot and freed pages are zeroed on free, only the
+  // link needs to be cleared
+  if (page)
+    ((struct run *)page)->next = NULL;
+#endif
+
+  return page;
+}
+
+void page_free(void *page) {
+  struct run *r = page;
+
+#ifndef PAGE_ZERO_LAZY
+  memset(page, 0, PAGE_SIZE);
+#endif
+
+  size_t sie = irq_save();
+  spin_lock(&lock);
+  r->next = freelist;
+  freelist = r;
+  nfree++;
+  spin_unlock(&lock);
+  irq_restore(sie);
+}
+
+size_t page_free_count() { return nfree; }
+
+// reserved ranges lie within the pool, but their pages are not counted. a
+// reference would free them, once it is dropped
+static volatile uint32_t *ref(void *page) {
+  uintptr_t p = (uintptr_t)page;
+  if (p < pool || p >= limit)
+    return NULL;
+  for (size_t i = 0; i < nreserved; i++)
+    if (p >= reserved[i].begin && p < reserved[i].end)
+      return NULL;
+  return &refs[(p - pool) / PAGE_SIZE];
+}
+
+void page_ref(void *page) {
+  volatile uint32_t *r = ref(page);
+  if (r)
+    amoadd(r, 1);
+}
+
+void page_unref(void *page) {
+  volatile uint32_t *r = ref(page);
+  if (r && amoadd(r, -1) == 1)
+    page_free(page);
+}
@@ -0,0 +1,39 @@
+#ifndef PAGE_H
+#define PAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PAGE_SIZE (4096)
+
+// the pool is zeroed in chunks of this size, so harts can share the work
+#define PAGE_ZERO_CHUNK (64 * PAGE_SIZE)
+
+// the most ranges that can be reserved
+#define PAGE_MAX_RESERVED (4)
+
+// keep a range, which holds data handed over at boot, out of the pool. it
+// is neither zeroed nor handed out. called before page_init
+void page_reserve(uintptr_t begin, uintptr_t end);
+
+// set up the pool between begin and end. called once, by the boot hart
+void page_init(uintptr_t begin, uintptr_t end);
+
+// zero chunks of the pool, until none are left. called by every hart, after
+// page_init. the boot hart waits with page_zero_wait for the others to finish
+void page_zero_share();
+void page_zero_wait();
+
+// allocated pages are always zeroed
+void *page_alloc();
+void page_free(void *page);
+size_t page_free_count();
+
+// pages mapped more than once are reference counted. page_alloc returns a
+// page with a count of 1, page_unref frees it, once the count drops to 0.
+// pages outside the pool, or in a reserved range like the initrd, are
+// ignored
+void page_ref(void *page);
+void page_unref(void *page);
+
+#endif
@@ -0,0 +1,198 @@
+#include "plic.h"
+#include "config.h"
+#include "console.h"
+#include "page.h"
+#include "rcu.h"
+#include "riscv.h"
+#include "softirq.h"
+#include "spinlock.h"
+#include "trapstat.h"
+
+// a driver with another priority, see plic_set_priority. it replaces the
+// registered one in the table, and is freed after a grace period, once it is
+// replaced in turn
+struct driver_copy {
+  struct rcu_head rcu;
+  struct irq_driver d;
+  const struct irq_driver *orig;
+};
+
+// read on every external interrupt, drivers come and go with rcu. the
+// updaters take the lock
+static const struct irq_driver *drivers[PLIC_NUM_SOURCES];
+static struct driver_copy *copies[PLIC_NUM_SOURCES];
+static struct spinlock update_lock;
+static size_t depth[MAX_HARTS];
+
+static inline volatile uint32_t *threshold(size_t ctx) {
+  return (volatile uint32_t *)plic_warl(PLIC_BASE, PLIC_THRESHOLD_OFFSET, ctx);
+}
+
+static inline volatile uint32_t *claim(size_t ctx) {
+  return (volatile uint32_t *)plic_warl(PLIC_BASE, PLIC_CLAIM_OFFSET, ctx);
+}
+
+void plic_hart_init() {
+  *threshold(plic_context(hartid(), PLIC_MODE_S)) = 0;
+}
+
+static void free_copy(struct rcu_head *head) {
+  page_unref((struct driver_copy *)head);
+}
+
+void plic_register(const struct irq_driver *d) {
+  // the table is sized for the largest plic, the board may have fewer
+  if (!d->src || d->src > board.plic_sources || d->src >= PLIC_NUM_SOURCES) {
+    print("plic: no source for ");
+    print(d->name);
+    print("\n");
+    return;
+  }
+
+  size_t sie = irq_save();
+  spin_lock(&update_lock);
+  struct driver_copy *old = copies[d->src];
+  *(volatile uint32_t *)plic_array(PLIC_BASE, PLIC_PRIORITY_OFFSET, d->src) =
+      d->priority;
+  rcu_assign_pointer(drivers[d->src], d);
+  copies[d->src] = NULL;
+  spin_unlock(&update_lock);
+  irq_restore(sie);
+
+  if (old)
+    call_rcu(&old->rcu, free_copy);
+}
+
+void plic_unregister(const struct irq_driver *d) {
+  if (!d->src || d->src >= PLIC_NUM_SOURCES)
+    return;
+
+  size_t sie = irq_save();
+  spin_lock(&update_lock);
+  struct driver_copy *c = copies[d->src];
+  int found = drivers[d->src] == d || (c && c->orig == d);
+  if (found) {
+    *(volatile uint32_t *)plic_array(PLIC_BASE, PLIC_PRIORITY_OFFSET,
+                                     d->src) = 0;
+    rcu_assign_pointer(drivers[d->src], NULL);
+    copies[d->src] = NULL;
+  }
+  spin_unlock(&update_lock);
+  irq_restore(sie);
+
+  if (!found)
+    return;
+  synchronize_rcu();
+  if (c)
+    page_unref(c);
+}
+
+int plic_set_priority(size_t src, uint32_t priority) {
+  if (!src || src >= PLIC_NUM_SOURCES || !priority ||
+      priority > PLIC_MAX_PRIORITY)
+    return 0;
+
+  // there is no allocator for small objects. priorities rarely change
+  struct driver_copy *c = page_alloc();
+  if (!c)
+    return 0;
+
+  size_t sie = irq_save();
+  spin_lock(&update_lock);
+  const struct irq_driver *d = drivers[src];
+  struct driver_copy *old = copies[src];
+  if (d) {
+    c->d = *d;
+    c->d.priority = priority;
+    c->orig = old ? old->orig : d;
+    *(volatile uint32_t *)plic_array(PLIC_BASE, PLIC_PRIORITY_OFFSET, src) =
+        priority;
+    rcu_assign_pointer(drivers[src], &c->d);
+    copies[src] = c;
+  }
+  spin_unlock(&update_lock);
+  irq_restore(sie);
+
+  if (!d) {
+    page_unref(c);
+    return 0;
+  }
+
+  // top halves may still run with the old copy, it is freed once they are
+  // done. the driver it came from is not plic's to free
+  if (old)
+    call_rcu(&old->rcu, free_copy);
+  return 1;
+}
+
+void plic_report() {
+  print("plic: source, driver, priority\n");
+  for (size_t src = 1; src < PLIC_NUM_SOURCES; src++) {
+    // printing may wait for the uart, which a read section must not. the
+    // names are not freed with the copies
+    rcu_read_lock();
+    const struct irq_driver *d = rcu_dereference(drivers[src]);
+    const char *name = d ? d->name : NULL;
+    uint32_t priority = d ? d->priority : 0;
+    rcu_read_unlock();
+
+    if (!name)
+      continue;
+    print("  ");
+    print_num(10, src);
+    print(", ");
+    print(name);
+    print(", ");
+    print_num(10, priority);
+    print("\n");
+  }
+}
+
+void plic_enable(size_t src, size_t hart) {
+  size_t ctx = plic_context(hart, PLIC_MODE_S);
+  *(volatile uint32_t *)plic_bits(PLIC_BASE, PLIC_ENABLE_OFFSET, ctx, src) |=
+      1 << (src % 32);
+}
+
+void plic_trap() {
+  size_t h = hartid();
+  size_t ctx = plic_context(h, PLIC_MODE_S);
+  size_t src = *claim(ctx);
+
+  // another hart got it first
+  if (!src)
+    return;
+
+  rcu_read_lock();
+  const struct irq_driver *d =
+      src < PLIC_NUM_SOURCES ? rcu_dereference(drivers[src]) : NULL;
+  uint32_t prev = *threshold(ctx);
+
+  // nothing can preempt the highest priority, so dont bother
+  size_t nest = d && d->priority < PLIC_MAX_PRIORITY &&
+                depth[h] < PLIC_MAX_NESTING;
+
+  if (nest) {
+    depth[h]++;
+    *threshold(ctx) = d->priority;
+    softirq_irqon();
+    csrs(sstatus, XSTATUS_SIE);
+  }
+
+  if (d) {
+    uint32_t start = rdcycle();
+    d->top(src);
+    trapstat_irq(src, rdcycle() - start);
+  }
+
+  if (nest) {
+    csrc(sstatus, XSTATUS_SIE);
+    depth[h]--;
+  }
+
+  // complete before the threshold is lowered, so the source can only
+  // interrupt again once this frame is gone
+  *claim(ctx) = src;
+  *threshold(ctx) = prev;
+  rcu_read_unlock();
+}
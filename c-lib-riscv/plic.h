@@ -0,0 +1,51 @@
+#ifndef PLIC_H
+#define PLIC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// qemu's virt machine has 95 sources and 7 priority levels
+#define PLIC_NUM_SOURCES (96)
+#define PLIC_MAX_PRIORITY (7)
+
+// external interrupts nest at most this deep on one hart
+#define PLIC_MAX_NESTING (4)
+
+// a driver declares the priority of its source. while its top half runs, the
+// hart only takes sources with a higher priority. latency critical devices
+// should use a high priority, bulk devices a low one
+struct irq_driver {
+  const char *name;
+  uint32_t src;
+  uint32_t priority;
+  void (*top)(size_t src);
+};
+
+// set the threshold of the calling hart to 0
+void plic_hart_init();
+
+// set the priority of the source and route it to the driver
+void plic_register(const struct irq_driver *d);
+
+// mask the source and drop the driver. once it returns, no hart runs its top
+// half anymore. only from the worker, see synchronize_rcu
+void plic_unregister(const struct irq_driver *d);
+
+// change the priority of the driver of a source at runtime. the driver is
+// replaced by a copy with the new priority. top halves, which are still
+// running, keep the old one, a previous copy is freed with call_rcu. returns
+// 0, if there is no driver or the priority is out of range
+int plic_set_priority(size_t src, uint32_t priority);
+
+// the drivers and their priorities
+void plic_report();
+
+// enable the source for the supervisor context of a hart
+void plic_enable(size_t src, size_t hart);
+
+// claim the pending source, run its top half and complete it. the threshold
+// is raised to the priority of the source and interrupts are enabled, so
+// higher priority sources can preempt the top half
+void plic_trap();
+
+#endif
@@ -0,0 +1,360 @@
+#include "pmp.h"
+#include "board.h"
+#include "console.h"
+#include "mcall.h"
+#include "page.h"
+#include "riscv.h"
+#include "vm.h"
+
+// provided by the linker script
+extern char __TEXT_BEGIN__[], __RODATA_BEGIN__[], __DATA_BEGIN__[];
+
+#define PMPCFG_RWX (PMPCFG_R | PMPCFG_W | PMPCFG_X)
+
+// the kernel regions, the task entries stay off
+static struct pmp_set kernel;
+static int kernel_ready;
+
+static int napot(uintptr_t begin, uintptr_t size) {
+  return size >= 8 && !(size & (size - 1)) && !(begin & (size - 1));
+}
+
+int pmp_encode(struct pmp_set *s, size_t first, size_t last,
+               const struct pmp_region *r, size_t n) {
+  size_t e = first;
+
+  for (size_t i = 0; i < n; i++) {
+    uintptr_t begin = r[i].begin, end = r[i].end;
+    uint8_t perm = r[i].perm & PMPCFG_RWX;
+
+    while (i + 1 < n && r[i + 1].begin == end &&
+           (r[i + 1].perm & PMPCFG_RWX) == perm)
+      end = r[++i].end;
+
+    // an end of 0 is the end of the address space
+    uintptr_t size = end - begin;
+    if (!size)
+      continue;
+
+    if (size == 4 || napot(begin, size)) {
+      if (e == last)
+        return 0;
+      if (size == 4) {
+        s->addr[e] = begin >> 2;
+        s->cfg[e] = PMPCFG_A_NA4 | perm;
+      } else {
+        s->addr[e] = (begin >> 2) | ((size >> 3) - 1);
+        s->cfg[e] = PMPCFG_A_NAPOT | perm;
+      }
+      e++;
+      continue;
+    }
+
+    // tor takes the bottom from the previous entry, for the first entry it
+    // is 0. pmpaddr holds bits 33 to 2 of the address on rv32
+    int bottom = e == 0 ? begin == 0
+                        : e > first &&
+                              (s->cfg[e - 1] & PMPCFG_A_MASK) <= PMPCFG_A_TOR &&
+                              s->addr[e - 1] == begin >> 2;
+    if (!bottom) {
+      if (e == last)
+        return 0;
+      s->addr[e] = begin >> 2;
+      s->cfg[e] = PMPCFG_A_OFF;
+      e++;
+    }
+    if (e == last)
+      return 0;
+    s->addr[e] = end ? end >> 2 : (uint32_t)1 << 30;
+    s->cfg[e] = PMPCFG_A_TOR | perm;
+    e++;
+  }
+
+  for (; e < last; e++) {
+    s->addr[e] = 0;
+    s->cfg[e] = PMPCFG_A_OFF;
+  }
+  return 1;
+}
+
+int pmp_init() {
+  struct pmp_region r[3 + BOARD_MAX_MEMORY + 2 + BOARD_MAX_VIRTIO];
+  struct board_range ram = board_ram();
+  size_t n = 0;
+
+  r[n++] = (struct pmp_region){(uintptr_t)__TEXT_BEGIN__,
+                               (uintptr_t)__RODATA_BEGIN__,
+                               PMPCFG_R | PMPCFG_X};
+  r[n++] = (struct pmp_region){(uintptr_t)__RODATA_BEGIN__,
+                               (uintptr_t)__DATA_BEGIN__, PMPCFG_R};
+  r[n++] = (struct pmp_region){(uintptr_t)__DATA_BEGIN__, ram.end, PMPCFG_RWX};
+  for (size_t i = 0; i < board.nmemory; i++)
+    if (board.memory[i].begin != ram.begin)
+      r[n++] = (struct pmp_region){board.memory[i].begin, board.memory[i].end,
+                                   PMPCFG_RWX};
+
+  r[n++] = (struct pmp_region){board.plic, board.plic + board.plic_size,
+                               PMPCFG_R | PMPCFG_W};
+  r[n++] = (struct pmp_region){board.uart.base, board.uart.base + 0x100,
+                               PMPCFG_R | PMPCFG_W};
+  for (size_t i = 0; i < board.nvirtio; i++)
+    r[n++] = (struct pmp_region){board.virtio[i].base,
+                                 board.virtio[i].base + 0x1000,
+                                 PMPCFG_R | PMPCFG_W};
+
+  if (!pmp_encode(&kernel, PMP_TASK_ENTRIES, PMP_ENTRIES, r, n)) {
+    print("pmp: too many regions, memory stays open\n");
+    return 0;
+  }
+
+  kernel_ready = 1;
+  return 1;
+}
+
+void pmp_hart_init() {
+  if (kernel_ready)
+    mcall(MCALL_PMP_LOAD, (size_t)&kernel, 0, PMP_ENTRIES);
+}
+
+// the csr number is part of the instruction, the registers cannot be indexed
+#define PMPADDR(i)                                                             \
+  case i:                                                                      \
+    csrw(pmpaddr##i, v);                                                       \
+    break;
+
+static void write_addr(size_t i, uint32_t v) {
+  switch (i) {
+    PMPADDR(0)
+    PMPADDR(1)
+    PMPADDR(2)
+    PMPADDR(3)
+    PMPADDR(4)
+    PMPADDR(5)
+    PMPADDR(6)
+    PMPADDR(7)
+    PMPADDR(8)
+    PMPADDR(9)
+    PMPADDR(10)
+    PMPADDR(11)
+    PMPADDR(12)
+    PMPADDR(13)
+    PMPADDR(14)
+    PMPADDR(15)
+  }
+}
+
+// 4 entries per pmpcfg register on rv32
+static uint32_t read_cfg(size_t i) {
+  uint32_t v = 0;
+  switch (i) {
+  case 0:
+    csrr(v, pmpcfg0);
+    break;
+  case 1:
+    csrr(v, pmpcfg1);
+    break;
+  case 2:
+    csrr(v, pmpcfg2);
+    break;
+  case 3:
+    csrr(v, pmpcfg3);
+    break;
+  }
+  return v;
+}
+
+static void write_cfg(size_t i, uint32_t v) {
+  switch (i) {
+  case 0:
+    csrw(pmpcfg0, v);
+    break;
+  case 1:
+    csrw(pmpcfg1, v);
+    break;
+  case 2:
+    csrw(pmpcfg2, v);
+    break;
+  case 3:
+    csrw(pmpcfg3, v);
+    break;
+  }
+}
+
+void pmp_load(const struct pmp_set *s, size_t first, size_t last) {
+  if (last > PMP_ENTRIES)
+    last = PMP_ENTRIES;
+
+  // machine mode is not checked, the order does not matter
+  for (size_t i = first; i < last; i++)
+    write_addr(i, s->addr[i]);
+
+  for (size_t w = first / 4; w < (last + 3) / 4; w++) {
+    uint32_t cfg = read_cfg(w);
+    for (size_t i = w * 4; i < w * 4 + 4; i++) {
+      if (i < first || i >= last)
+        continue;
+      size_t shift = (i % 4) * 8;
+      cfg = (cfg & ~((uint32_t)0xff << shift)) | (uint32_t)s->cfg[i] << shift;
+    }
+    write_cfg(w, cfg);
+  }
+
+  // the hart may cache pmp checks along with translations
+  sfence_vma_all;
+}
+
+void pmp_report() {
+  if (!kernel_ready) {
+    print("pmp: off, memory is open\n");
+    return;
+  }
+
+  print("pmp: entry, mode, begin, end, perm\n");
+  for (size_t i = PMP_TASK_ENTRIES; i < PMP_ENTRIES; i++) {
+    uint32_t addr = kernel.addr[i];
+    uint8_t cfg = kernel.cfg[i];
+    uint64_t begin, end;
+    const char *mode;
+
+    switch (cfg & PMPCFG_A_MASK) {
+    case PMPCFG_A_TOR:
+      mode = "tor";
+      begin = i ? (uint64_t)kernel.addr[i - 1] << 2 : 0;
+      end = (uint64_t)addr << 2;
+      break;
+    case PMPCFG_A_NA4:
+      mode = "na4";
+      begin = (uint64_t)addr << 2;
+      end = begin + 4;
+      break;
+    case PMPCFG_A_NAPOT: {
+      // the number of trailing ones gives the size
+      size_t t = __builtin_ctz(~addr);
+      mode = "napot";
+      begin = (uint64_t)(addr & ~(((uint32_t)1 << t) - 1)) << 2;
+      end = begin + ((uint64_t)8 << t);
+      break;
+    }
+    default:
+      continue;
+    }
+
+    print("  ");
+    print_num(10, i);
+    print(", ");
+    print(mode);
+    print(", 0x");
+    print_num(16, begin);
+    print(", 0x");
+    print_num(16, end);
+    print(", ");
+    print(cfg & PMPCFG_R ? "r" : "-");
+    print(cfg & PMPCFG_W ? "w" : "-");
+    print(cfg & PMPCFG_X ? "x" : "-");
+    print("\n");
+  }
+}
+
+#define BENCH_PAGES (512)
+#define BENCH_SWITCHES (1000)
+#define BENCH_ROUNDS (16)
+
+static uintptr_t phys[BENCH_PAGES];
+static uintptr_t virt[BENCH_PAGES];
+
+// what a switch to a task with regions of its own costs
+static void load_task(const struct pmp_set *task) {
+  mcall(MCALL_PMP_LOAD, (size_t)task, 0, PMP_TASK_ENTRIES);
+}
+
+// a word of every page, the page walks of sv32 show up here
+static uint32_t touch(const uintptr_t *pages) {
+  uint32_t sum = 0;
+  for (size_t i = 0; i < BENCH_PAGES; i++)
+    sum += *(volatile uint32_t *)pages[i];
+  return sum;
+}
+
+static void bench_report(const char *name, uint32_t switches, uint32_t total) {
+  print(name);
+  print(": switch cycles ");
+  print_num(10, switches / BENCH_SWITCHES);
+  print(", cycles per access after a switch ");
+  print_num(10, total / (BENCH_ROUNDS * BENCH_PAGES));
+  print("\n");
+}
+
+void pmp_bench() {
+  if (!kernel_ready) {
+    print("pmp: off\n");
+    return;
+  }
+
+  struct vm vm = {0};
+  if (!vm_create(&vm)) {
+    print("pmp: out of memory\n");
+    return;
+  }
+
+  // the same pages, mapped by a page table, or reached directly, with the
+  // task entries opening their range
+  size_t n = 0;
+  struct pmp_region task = {~(uintptr_t)0, 0, PMPCFG_R | PMPCFG_W};
+  for (; n < BENCH_PAGES; n++) {
+    void *page = page_alloc();
+    if (!page)
+      break;
+    phys[n] = (uintptr_t)page;
+    virt[n] = USER_BASE + n * PAGE_SIZE;
+    vm_map_page(&vm, virt[n], page, PTE_R | PTE_W);
+    page_unref(page);
+
+    if (phys[n] < task.begin)
+      task.begin = phys[n];
+    if (phys[n] + PAGE_SIZE > task.end)
+      task.end = phys[n] + PAGE_SIZE;
+  }
+
+  struct pmp_set set;
+  if (n < BENCH_PAGES ||
+      !pmp_encode(&set, 0, PMP_TASK_ENTRIES, &task, 1)) {
+    print("pmp: out of memory\n");
+    vm_destroy(&vm);
+    return;
+  }
+
+  size_t sie = irq_save();
+
+  uint32_t start = rdcycle();
+  for (size_t i = 0; i < BENCH_SWITCHES; i++)
+    load_task(&set);
+  uint32_t switches = rdcycle() - start;
+
+  start = rdcycle();
+  for (size_t i = 0; i < BENCH_ROUNDS; i++) {
+    load_task(&set);
+    touch(phys);
+  }
+  bench_report("pmp", switches, rdcycle() - start);
+  load_task(&kernel);
+
+  // the kernel reaches user pages with sum
+  csrs(sstatus, XSTATUS_SUM);
+  start = rdcycle();
+  for (size_t i = 0; i < BENCH_SWITCHES; i++)
+    vm_activate(&vm);
+  switches = rdcycle() - start;
+
+  start = rdcycle();
+  for (size_t i = 0; i < BENCH_ROUNDS; i++) {
+    vm_activate(&vm);
+    touch(virt);
+  }
+  uint32_t total = rdcycle() - start;
+  vm_deactivate();
+  csrc(sstatus, XSTATUS_SUM);
+  bench_report("sv32", switches, total);
+
+  irq_restore(sie);
+  vm_destroy(&vm);
+}
@@ -0,0 +1,71 @@
+#ifndef PMP_H
+#define PMP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// physical memory protection, as a protection mode without translation.
+//
+// pmp checks the accesses of supervisor and user mode against a few physical
+// regions. there is no page table to walk, and no tlb to miss. the registers
+// can only be written in machine mode, the kernel asks for it with an ecall,
+// see mcall.h.
+//
+// the entries are split in two. the first PMP_TASK_ENTRIES are left to the
+// regions of a task. they take priority, so a task region can hide memory
+// from the task, or open it up, in front of the kernel regions, which fill
+// the rest:
+//
+// * kernel text is rx, rodata r
+// * the rest of the ram is rwx, as the page pool hands out user code as well
+// * the mmio windows of the devices the kernel drives are rw
+//
+// without smepmp, pmp does not tell supervisor from user mode. a task, which
+// runs without paging, may access everything the kernel can, unless its own
+// regions hide it. processes run with paging, and their regions would bind
+// the kernel in their traps as well, so no switch installs any. only
+// pmp_bench loads task regions, to weigh pmp-only isolation against sv32.
+
+// qemu implements all 16 entries
+#define PMP_ENTRIES (16)
+#define PMP_TASK_ENTRIES (4)
+
+struct pmp_region {
+  uintptr_t begin, end;
+  // PMPCFG_R, PMPCFG_W and PMPCFG_X
+  uint8_t perm;
+};
+
+// the encoded registers, the value of pmpaddr and the pmpcfg byte per entry
+struct pmp_set {
+  uint32_t addr[PMP_ENTRIES];
+  uint8_t cfg[PMP_ENTRIES];
+};
+
+// encode the regions into the entries [first, last) of s, the unused ones
+// are turned off. a region takes one entry, if it is 4 bytes, na4, or a
+// naturally aligned power of 2, napot. otherwise it takes two, an off entry
+// for the bottom and a tor entry for the top. the off entry is left out, if
+// the previous entry ends where the region begins. regions are 4 byte
+// aligned, adjacent ones with the same permissions are merged. returns 0, if
+// they do not fit
+int pmp_encode(struct pmp_set *s, size_t first, size_t last,
+               const struct pmp_region *r, size_t n);
+
+// encode the kernel regions of the board. called once, by the boot hart.
+// returns 0, if they do not fit, then memory stays open
+int pmp_init();
+
+// load the kernel regions on the calling hart, without task regions
+void pmp_hart_init();
+
+// write the entries [first, last) to the registers. machine mode only
+void pmp_load(const struct pmp_set *s, size_t first, size_t last);
+
+// the kernel regions, decoded
+void pmp_report();
+
+// switch and access cost, pmp regions against sv32 page tables
+void pmp_bench();
+
+#endif
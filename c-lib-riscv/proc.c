@@ -0,0 +1,55 @@
+#include "proc.h"
+#include "config.h"
+#include "console.h"
+#include "elf.h"
+#include "initrd.h"
+#include "riscv.h"
+#include "vdso.h"
+
+static struct proc *current[MAX_HARTS];
+
+struct proc *proc_current() { return current[hartid()]; }
+
+int proc_exec(const char *path, size_t *status) {
+  struct initrd_file f;
+  struct proc p = {.name = path};
+  uintptr_t entry;
+
+  if (!initrd_find(path, &f))
+    return 0;
+
+  if (!vm_create(&p.vm))
+    return 0;
+
+  if (!elf_load(f.data, f.size, &p.vm, &entry) ||
+      !vm_map(&p.vm, USER_STACK_TOP - USER_STACK_SIZE, USER_STACK_TOP,
+              PTE_R | PTE_W, NULL, 0) ||
+      !vm_map_page(&p.vm, VDSO_BASE, vdso_page(), PTE_R)) {
+    vm_destroy(&p.vm);
+    return 0;
+  }
+
+  size_t sie = irq_save();
+  current[hartid()] = &p;
+  vm_activate(&p.vm);
+
+  // system calls access user memory directly
+  csrs(sstatus, XSTATUS_SUM);
+  fpu_thread_start(&p.fpu);
+
+  *status = user_enter(&p.context, entry, USER_STACK_TOP);
+
+  // back from a trap, with interrupts off. the kernel runs with the fpu off
+  fpu_switch(&p.fpu, NULL);
+  csrc(sstatus, XSTATUS_SUM);
+  vm_deactivate();
+  current[hartid()] = NULL;
+  irq_restore(sie);
+
+  vm_destroy(&p.vm);
+  return 1;
+}
+
+void proc_exit(size_t status) {
+  user_return(&proc_current()->context, status);
+}
@@ -0,0 +1,35 @@
+#ifndef PROC_H
+#define PROC_H
+
+#include "fpu.h"
+#include "trap.h"
+#include "vm.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// user mode processes. a process runs on the hart which started it, inside
+// proc_exec, until it exits or is killed. there is no scheduler yet, the
+// worker of the hart is blocked in the meantime, interrupts are still served.
+
+struct proc {
+  const char *name;
+  struct vm vm;
+  struct user_context context;
+  // the fpu is turned on lazily, by its first fp instruction, see fpu.h
+  struct fpu_state fpu;
+};
+
+// load an executable from the initrd and run it. returns 0, if it could not
+// be loaded, or 1 and the exit status in status. killed processes exit with
+// PROC_KILLED
+int proc_exec(const char *path, size_t *status);
+
+#define PROC_KILLED ((size_t)-1)
+
+// the process running on the calling hart, or NULL
+struct proc *proc_current();
+
+// leave the current process, from a trap. proc_exec returns status
+void proc_exit(size_t status) __attribute__((noreturn));
+
+#endif
@@ -0,0 +1,124 @@
+#include "rcu.h"
+#include "atomic.h"
+#include "config.h"
+#include "console.h"
+#include "riscv.h"
+#include "softirq.h"
+#include "spinlock.h"
+
+// each hart bumps its own counter, a grace period is over once every online
+// hart bumped it, or was asleep, after it started
+static volatile uint32_t qs[MAX_HARTS];
+static volatile uint32_t asleep[MAX_HARTS];
+static volatile uint32_t online[MAX_HARTS];
+
+// callbacks wait in a batch, a work item runs a grace period for all of them
+static struct spinlock cb_lock;
+static struct rcu_head *pending;
+static uint32_t queued;
+
+static struct {
+  uint32_t grace_periods;
+  uint32_t callbacks;
+  uint64_t max_ticks;
+} stats;
+
+void rcu_hart_init() {
+  store_release(&online[hartid()], 1);
+}
+
+void rcu_quiescent() {
+  size_t h = hartid();
+  // the reads before it are done, once the count changes
+  store_release(&qs[h], qs[h] + 1);
+}
+
+void rcu_idle_enter() {
+  size_t h = hartid();
+  store_release(&asleep[h], 1);
+}
+
+void rcu_idle_exit() {
+  asleep[hartid()] = 0;
+  // the reads after waking up see what was published while asleep
+  fence;
+}
+
+void synchronize_rcu() {
+  size_t self = hartid();
+  uint32_t snap[MAX_HARTS];
+  uint64_t start = rdtime();
+
+  // readers, which see the old version, started before the snapshot
+  fence;
+  for (size_t h = 0; h < MAX_HARTS; h++)
+    snap[h] = qs[h];
+
+  for (size_t h = 0; h < MAX_HARTS; h++) {
+    if (h == self || !online[h])
+      continue;
+    // another hart may wait for this one as well
+    while (!asleep[h] && qs[h] == snap[h])
+      rcu_quiescent();
+  }
+  fence;
+
+  uint64_t ticks = rdtime() - start;
+  amoadd(&stats.grace_periods, 1);
+  if (ticks > stats.max_ticks)
+    stats.max_ticks = ticks;
+}
+
+static void run_callbacks(size_t arg) {
+  for (;;) {
+    size_t sie = irq_save();
+    spin_lock(&cb_lock);
+    struct rcu_head *batch = pending;
+    pending = NULL;
+    if (!batch)
+      queued = 0;
+    spin_unlock(&cb_lock);
+    irq_restore(sie);
+
+    if (!batch)
+      return;
+
+    // callbacks queued from now on wait for the next round
+    synchronize_rcu();
+    while (batch) {
+      struct rcu_head *next = batch->next;
+      batch->fn(batch);
+      amoadd(&stats.callbacks, 1);
+      batch = next;
+    }
+  }
+}
+
+void call_rcu(struct rcu_head *head, void (*fn)(struct rcu_head *head)) {
+  head->fn = fn;
+
+  size_t sie = irq_save();
+  spin_lock(&cb_lock);
+  head->next = pending;
+  pending = head;
+  int start = !queued;
+  queued = 1;
+  spin_unlock(&cb_lock);
+
+  if (start && !work_queue(hartid(), run_callbacks, 0)) {
+    spin_lock(&cb_lock);
+    queued = 0;
+    spin_unlock(&cb_lock);
+  }
+  irq_restore(sie);
+}
+
+void rcu_report() {
+  print("rcu: grace periods ");
+  print_num(10, stats.grace_periods);
+  print(", max us ");
+  print_num(10, stats.max_ticks / (TIMEBASE_HZ / 1000000));
+  print(", callbacks ");
+  print_num(10, stats.callbacks);
+  print("\n");
+}
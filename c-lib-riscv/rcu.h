@@ -0,0 +1,67 @@
+#ifndef RCU_H
+#define RCU_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// read-copy-update, for tables which are read on every interrupt, but rarely
+// change.
+//
+// readers take no lock and write nothing shared. rcu_read_lock only keeps the
+// compiler from moving loads out of the section. a writer publishes a new
+// version with a release store, and frees the old one once every hart went
+// through a quiescent state, a point where it cannot hold a reference:
+//
+// * between two work items, and in the idle loop
+// * while the hart sleeps in wfi, that state lasts until it wakes up
+// * on a trap from user mode, an interrupt or an exception
+//
+// a read section must not span any of them. it may not sleep, and it ends
+// before the trap it started in returns. harts count once they called
+// rcu_hart_init, the parked hart 0 never does.
+//
+// a long work item on one hart, like a process, holds up grace periods.
+// call_rcu does not wait for them.
+
+#define rcu_read_lock() asm volatile("" ::: "memory")
+#define rcu_read_unlock() asm volatile("" ::: "memory")
+
+// a plain load. the loads through the pointer depend on its address, rvwmo
+// keeps them in order
+#define rcu_dereference(p) (*(__typeof__(p) volatile *)&(p))
+
+// the new version is complete, before the pointer to it is visible
+#define rcu_assign_pointer(p, v)                                               \
+  do {                                                                         \
+    asm volatile("fence rw, w" ::: "memory");                                  \
+    *(__typeof__(p) volatile *)&(p) = (v);                                     \
+  } while (0)
+
+// embed it as the first member of the object to free
+struct rcu_head {
+  struct rcu_head *next;
+  void (*fn)(struct rcu_head *head);
+};
+
+void rcu_hart_init();
+
+// report a quiescent state of the calling hart
+void rcu_quiescent();
+
+// the calling hart sleeps, and leaves it again. interrupts are disabled, so
+// no trap reads in between
+void rcu_idle_enter();
+void rcu_idle_exit();
+
+// wait until every read section, which started before the call, ended. only
+// from the worker, with no locks held and interrupts enabled
+void synchronize_rcu();
+
+// call fn, after a grace period, from the worker of the calling hart. may be
+// called from a trap
+void call_rcu(struct rcu_head *head, void (*fn)(struct rcu_head *head));
+
+// grace periods and callbacks so far
+void rcu_report();
+
+#endif
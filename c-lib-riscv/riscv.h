@@ -1,6 +1,8 @@
 #ifndef RISCV_H
 #define RISCV_H
 
+#include "board.h"
+#include "config.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -12,6 +14,11 @@
   asm volatile("mret");                                                        \
   __builtin_unreachable()
 
+// flush the cached translations of a single page, on the calling hart
+#define sfence_vma(va)                                                         \
+  asm volatile("sfence.vma %0, zero" ::"r"(va) : "memory")
+#define sfence_vma_all asm volatile("sfence.vma zero, zero" ::: "memory")
+
 
 static inline size_t hartid() {
   int _hid;
@@ -26,6 +33,29 @@ static inline size_t hartid() {
 #define csrs(csr, rs1) asm volatile("csrs " #csr ", %0" ::"r"(rs1))
 #define csrc(csr, rs1) asm volatile("csrc " #csr ", %0" ::"r"(rs1))
 
+// the time csr is 64 bit, but on rv32 it is read in 2 halves. read the upper
+// half twice, to detect a carry between the reads
+static inline uint64_t rdtime() {
+  uint32_t hi, lo, tmp;
+  do {
+    csrr(hi, timeh);
+    csrr(lo, time);
+    csrr(tmp, timeh);
+  } while (hi != tmp);
+  return ((uint64_t)hi << 32) | lo;
+}
+
+// the lower half of the cycle counter, for short intervals. the difference of
+// two reads is right, as long as less than 2^32 cycles passed
+static inline uint32_t rdcycle() {
+  uint32_t lo;
+  csrr(lo, cycle);
+  return lo;
+}
+
+// the board constants come from the device tree, see board.h
+#define TIMEBASE_HZ (board.timebase_hz)
+
 // control and status registers
 
 // the reigsters are layed out such that higher privleges are supersets of lower
@@ -66,6 +96,29 @@ static inline size_t hartid() {
 #define XSTATUS_SPP (1 << 8)
 #define XSTATUS_MPP_M (3 << 11)
 #define XSTATUS_MPP_S (1 << 11)
+// permit supervisor user memory access
+#define XSTATUS_SUM (1 << 18)
+
+// the FS field tracks the state of the floating point unit. when it is off,
+// any fp instruction raises an illegal instruction exception. the hardware
+// moves it to dirty, as soon as any fp register or fcsr is written
+#define XSTATUS_FS_MASK (3 << 13)
+#define XSTATUS_FS_OFF (0 << 13)
+#define XSTATUS_FS_INITIAL (1 << 13)
+#define XSTATUS_FS_CLEAN (2 << 13)
+#define XSTATUS_FS_DIRTY (3 << 13)
+
+// disable supervisor interrupts and return, whether they have been enabled
+static inline size_t irq_save() {
+  size_t status;
+  asm volatile("csrrc %0, sstatus, %1" : "=r"(status) : "r"(XSTATUS_SIE));
+  return status & XSTATUS_SIE;
+}
+
+static inline void irq_restore(size_t sie) {
+  if (sie)
+    csrs(sstatus, sie);
+}
 
 // xie register
 
@@ -162,6 +215,8 @@ static const char *irq_names[] = {
 #define EXC_BREAKPOINT (3)
 #define EXC_LOAD_ACCESS_FAULT (5)
 #define EXC_STORE_AMO_ACCESS_FAULT (7)
+#define EXC_ENVIRONMENT_CALL_FROM_U_MODE (8)
+#define EXC_ENVIRONMENT_CALL_FROM_S_MODE (9)
 #define EXC_INSTRUCTION_PAGE_FAULT (12)
 #define EXC_LOAD_PAGE_FAULT (13)
 #define EXC_STORE_AMO_PAGE_FAULT (15)
@@ -172,6 +227,8 @@ static const char *exception_names[] = {
     [EXC_BREAKPOINT] = "Breakpoint",
     [EXC_LOAD_ACCESS_FAULT] = "Load access fault",
     [EXC_STORE_AMO_ACCESS_FAULT] = "Store/AMO access fault",
+    [EXC_ENVIRONMENT_CALL_FROM_U_MODE] = "Environment call from U-mode",
+    [EXC_ENVIRONMENT_CALL_FROM_S_MODE] = "Environment call from S-mode",
     [EXC_INSTRUCTION_PAGE_FAULT] = "Instruction page fault",
     [EXC_LOAD_PAGE_FAULT] = "Load page fault",
     [EXC_STORE_AMO_PAGE_FAULT] = "Store/AMO page fault",
@@ -285,6 +342,22 @@ struct __attribute__((packed)) Sv32PhysicalAddress {
   uint32_t ppn1 : 10;
 };
 
+#define PTE_V (1 << 0)
+#define PTE_R (1 << 1)
+#define PTE_W (1 << 2)
+#define PTE_X (1 << 3)
+#define PTE_U (1 << 4)
+#define PTE_G (1 << 5)
+#define PTE_A (1 << 6)
+#define PTE_D (1 << 7)
+// the rsw bits are left to the kernel
+#define PTE_RSW0 (1 << 8)
+#define PTE_RSW1 (1 << 9)
+
+#define PTE_PPN_SHIFT (10)
+#define PTE_TO_PA(pte) (((uintptr_t)(pte) >> PTE_PPN_SHIFT) << 12)
+#define PA_TO_PTE(pa) (((uintptr_t)(pa) >> 12) << PTE_PPN_SHIFT)
+
 //  31 20 19  10 9 8 7 6 5 4 3 2 1 0
 // PPN[1] PPN[0] RSW D A G U X W R V
 //    12     10    2 1 1 1 1 1 1 1 1
@@ -416,9 +489,9 @@ static inline size_t plic_warl(size_t base, size_t offset, size_t context) {
   return base + offset + context * PLIC_WARL_STRIDE;
 }
 
-// deviding the source by the alignment gives the word offset, the remainder
-// gives the bit offset in the word and the base is added to get the address
-// of the bit:
+// deviding the source by the alignment gives the word offset, times the word
+// size gives the byte offset. the remainder gives the bit offset in the word
+// and the base is added to get the address of the bit:
 //
 //      id = 31 -> word = 31 / 32 = 0
 //      id = 32 -> word = 32 / 32 = 1
@@ -430,12 +503,11 @@ static inline size_t plic_warl(size_t base, size_t offset, size_t context) {
 //      id = 32 -> bit = 32 % 32 = 0
 //
 static inline size_t plic_bits(size_t base, size_t offset, size_t context, size_t src) {
-  return base + offset + context * PLIC_BITS_STRIDE + src / PLIC_ALIGNMENT;
+  return base + offset + context * PLIC_BITS_STRIDE +
+         src / PLIC_ALIGNMENT * PLIC_WORDSIZE;
 }
 
-#ifdef BOARD_QEMU_RISCV_VIRT
-#define PLIC_BASE (0x0c000000)
-#endif
+#define PLIC_BASE (board.plic)
 
 // stride here is fixed as showed on the ISA spec. above calculation produces
 // the same result but is less clear to the reader. Therefore plain values are
@@ -466,13 +538,8 @@ static inline size_t plic_bits(size_t base, size_t offset, size_t context, size_
 
 // uart
 
-#ifdef BOARD_QEMU_RISCV_VIRT
-#define UART_BASE (0x10000000)
-#define PLIC_SRC_UART (10)
-#else
-#define UART_BASE (0x0)
-#define PLIC_SRC_UART (0)
-#endif
+#define UART_BASE (board.uart.base)
+#define PLIC_SRC_UART (board.uart.irq)
 // 8 bit registers
 // +0	0	Read	RBR	Receiver Buffer
 #define UART_RBR (0x0)
@@ -616,34 +683,4 @@ struct __attribute__((packed)) UartLSR {
   uint8_t error_in_rx_fifo : 1;
 };
 
-static inline void uart_write(const char c) {
-    struct UartLSR *volatile _lsr = (struct UartLSR *)(UART_BASE + UART_LSR);
-  while (!_lsr->empty_thr)
-    ;
-
-  *(volatile char *)(UART_BASE + UART_THR) = c;
-
-  if (c == '\n')
-    uart_write('\r');
-}
-
-static inline char uart_read() {
-  struct UartLSR *volatile _lsr = (struct UartLSR *)(UART_BASE + UART_LSR);
-  while (!_lsr->data_ready)
-    ;
-
-  char c = *(volatile char *)(UART_BASE + UART_RBR);
-
-  if (c == '\r')
-    c = '\n';
-
-  return c;
-}
-
-static inline void uart_flush() {
-  struct UartLSR *volatile _lsr = (struct UartLSR *)(UART_BASE + UART_LSR);
-  while (!_lsr->empty_dhr)
-    ;
-}
-
 #endif
@@ -0,0 +1,189 @@
+#include "shell.h"
+#include "bcache.h"
+#include "board.h"
+#include "boot.h"
+#include "idle.h"
+#include "console.h"
+#include "initrd.h"
+#include "plic.h"
+#include "pmp.h"
+#include "proc.h"
+#include "rcu.h"
+#include "softirq.h"
+#include "stack.h"
+#include "trapstat.h"
+#include "uart.h"
+#include "virtio_blk.h"
+#include "vm.h"
+
+struct command {
+  const char *name;
+  const char *help;
+  void (*fn)();
+  // commands, which take the rest of the line
+  void (*fn_args)(const char *args);
+};
+
+static void help();
+static void console();
+static void run(const char *path);
+static void traps(const char *args);
+static void irqprio(const char *args);
+
+static const struct command commands[] = {
+    {"help", "list commands", help},
+    {"boot", "boot phase timing", boot_report},
+    {"board", "devices found in the device tree", board_report},
+    {"irqoff", "worst case time with interrupts off", softirq_report},
+    {"stacks", "stack high-water marks", stack_report},
+    {"idle", "idle polling and wake-up latency", idle_report},
+    {"traps", "trap counts and cycle histograms: traps [reset]", NULL, traps},
+    {"blkbench", "virtio-blk queue depth against throughput", blk_bench},
+    {"cache", "buffer cache stats", bcache_report},
+    {"cachebench", "sequential reads through the buffer cache", bcache_bench},
+    {"console", "switch console output between uart and virtio", console},
+    {"initrd", "list the files in the initrd", initrd_list},
+    {"conbench", "log dump throughput, uart against virtio", console_bench},
+    {"pmp", "kernel pmp regions", pmp_report},
+    {"pmpbench", "switch and access cost, pmp against sv32", pmp_bench},
+    {"rcu", "grace periods and callbacks", rcu_report},
+    {"irqprio", "driver priorities: irqprio [<source> <priority>]", NULL,
+     irqprio},
+    {"run", "run a program from the initrd: run <path>", NULL, run},
+    {"vm", "page fault and sharing stats", vm_report},
+    {"uart", "wait queue of the uart writers", uart_report},
+};
+
+#define NUM_COMMANDS (sizeof(commands) / sizeof(commands[0]))
+
+static char line[64];
+static size_t len;
+
+static void help() {
+  for (size_t i = 0; i < NUM_COMMANDS; i++) {
+    print("  ");
+    print(commands[i].name);
+    print(" - ");
+    print(commands[i].help);
+    print("\n");
+  }
+}
+
+static void console() {
+  enum console_backend b = console_backend() == CONSOLE_UART
+                               ? CONSOLE_VIRTIO
+                               : CONSOLE_UART;
+
+  if (console_select(b) == CONSOLE_VIRTIO)
+    print("console: virtio\n");
+  else
+    print("console: uart\n");
+}
+
+static void run(const char *path) {
+  size_t status;
+
+  if (!proc_exec(path, &status)) {
+    print("run: cannot load ");
+    print(path);
+    print("\n");
+    return;
+  }
+
+  print("run: exit status ");
+  if (status == PROC_KILLED)
+    print("killed");
+  else
+    print_num(10, status);
+  print("\n");
+}
+
+static int streq(const char *a, const char *b) {
+  while (*a && *a == *b)
+    a++, b++;
+  return *a == *b;
+}
+
+static void traps(const char *args) {
+  if (streq(args, "reset"))
+    trapstat_reset();
+  else
+    trapstat_report();
+}
+
+// a decimal number, the spaces after it are skipped. returns 0, if there is
+// none
+static int number(const char **s, size_t *v) {
+  const char *p = *s;
+  *v = 0;
+  while (*p >= '0' && *p <= '9')
+    *v = *v * 10 + (*p++ - '0');
+  if (p == *s)
+    return 0;
+  while (*p == ' ')
+    p++;
+  *s = p;
+  return 1;
+}
+
+static void irqprio(const char *args) {
+  size_t src, priority;
+
+  if (*args) {
+    if (!number(&args, &src) || !number(&args, &priority) || *args) {
+      print("irqprio: irqprio <source> <priority>\n");
+      return;
+    }
+    if (!plic_set_priority(src, priority)) {
+      print("irqprio: no driver, or priority not in 1-7\n");
+      return;
+    }
+  }
+  plic_report();
+}
+
+static void exec() {
+  if (!len)
+    return;
+
+  // the name ends at the first space, the arguments follow
+  char *args = line;
+  while (*args && *args != ' ')
+    args++;
+  if (*args)
+    *args++ = '\0';
+  while (*args == ' ')
+    args++;
+
+  for (size_t i = 0; i < NUM_COMMANDS; i++) {
+    if (streq(line, commands[i].name)) {
+      if (commands[i].fn_args)
+        commands[i].fn_args(args);
+      else
+        commands[i].fn();
+      return;
+    }
+  }
+
+  print("unknown command: ");
+  print(line);
+  print("\n");
+}
+
+void shell_input(size_t c) {
+  switch (c) {
+  case '\n':
+    line[len] = '\0';
+    exec();
+    len = 0;
+    break;
+  case '\b':
+  case 0x7f:
+    if (len)
+      len--;
+    break;
+  default:
+    if (len < sizeof(line) - 1)
+      line[len++] = c;
+  }
+}
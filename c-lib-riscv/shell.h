@@ -0,0 +1,10 @@
+#ifndef SHELL_H
+#define SHELL_H
+
+#include <stddef.h>
+
+// feed a character typed on the console. a full line is run as command.
+// runs in the worker of the hart receiving console input
+void shell_input(size_t c);
+
+#endif
@@ -0,0 +1,155 @@
+#include "softirq.h"
+#include "config.h"
+#include "console.h"
+#include "idle.h"
+#include "rcu.h"
+#include "riscv.h"
+#include "spinlock.h"
+
+struct queue {
+  struct work items[SOFTIRQ_QUEUE_SIZE];
+  size_t head;
+  size_t tail;
+};
+
+static struct queue softirqs[MAX_HARTS];
+static size_t running[MAX_HARTS];
+static size_t nesting[MAX_HARTS];
+
+static struct queue works[MAX_HARTS];
+static struct spinlock works_lock[MAX_HARTS];
+
+static uint64_t irqoff_start[MAX_HARTS];
+static uint64_t irqoff_max[MAX_HARTS];
+static size_t irqoff_cause[MAX_HARTS];
+
+static int push(struct queue *q, work_fn fn, size_t arg) {
+  if (q->tail - q->head == SOFTIRQ_QUEUE_SIZE)
+    return 0;
+  q->items[q->tail++ % SOFTIRQ_QUEUE_SIZE] = (struct work){fn, arg};
+  return 1;
+}
+
+static int pop(struct queue *q, struct work *w) {
+  if (q->tail == q->head)
+    return 0;
+  *w = q->items[q->head++ % SOFTIRQ_QUEUE_SIZE];
+  return 1;
+}
+
+// the queues of a hart are shared between its bottom halves and nested top
+// halves, so they are only touched with interrupts off
+int softirq_raise(work_fn fn, size_t arg) {
+  size_t sie = irq_save();
+  int ok = push(&softirqs[hartid()], fn, arg);
+  irq_restore(sie);
+  return ok;
+}
+
+void softirq_enter() {
+  size_t h = hartid();
+  nesting[h]++;
+  irqoff_start[h] = rdtime();
+}
+
+void softirq_irqon() {
+  size_t h = hartid();
+
+  // only the first time interrupts are enabled in a trap counts
+  if (!irqoff_start[h])
+    return;
+
+  uint64_t off = rdtime() - irqoff_start[h];
+  irqoff_start[h] = 0;
+
+  if (off > irqoff_max[h]) {
+    irqoff_max[h] = off;
+    csrr(irqoff_cause[h], scause);
+  }
+}
+
+void softirq_exit() {
+  size_t h = hartid();
+  struct queue *q = &softirqs[h];
+  struct work w;
+
+  softirq_irqon();
+  nesting[h]--;
+
+  // a nested trap leaves its work to the outer one, which is either still in
+  // its top half, or already draining the queue below
+  if (nesting[h] || running[h] || q->tail == q->head)
+    return;
+
+  running[h] = 1;
+
+  // check again with interrupts off, so nothing raised between the last pop
+  // and leaving is stranded until the next trap
+  do {
+    csrs(sstatus, XSTATUS_SIE);
+    for (;;) {
+      size_t sie = irq_save();
+      int ok = pop(q, &w);
+      irq_restore(sie);
+      if (!ok)
+        break;
+      w.fn(w.arg);
+    }
+    csrc(sstatus, XSTATUS_SIE);
+  } while (q->tail != q->head);
+
+  running[h] = 0;
+}
+
+int softirq_in_trap() {
+  size_t h = hartid();
+  return nesting[h] || running[h];
+}
+
+int work_queue(size_t hart, work_fn fn, size_t arg) {
+  size_t sie = irq_save();
+  spin_lock(&works_lock[hart]);
+  int ok = push(&works[hart], fn, arg);
+  if (ok)
+    idle_arrival(hart);
+  spin_unlock(&works_lock[hart]);
+  irq_restore(sie);
+  return ok;
+}
+
+int work_pending() {
+  struct queue *q = &works[hartid()];
+  return q->tail != q->head;
+}
+
+void work_run() {
+  size_t h = hartid();
+  struct work w;
+
+  for (;;) {
+    size_t sie = irq_save();
+    spin_lock(&works_lock[h]);
+    int ok = pop(&works[h], &w);
+    spin_unlock(&works_lock[h]);
+    irq_restore(sie);
+    if (!ok)
+      break;
+    w.fn(w.arg);
+    rcu_quiescent();
+  }
+}
+
+void softirq_report() {
+  print("irqoff: hart, max ns, scause\n");
+  for (size_t h = 0; h < board.harts; h++) {
+    if (!irqoff_max[h])
+      continue;
+    print("  ");
+    print_num(10, h);
+    print(", ");
+    print_num(10, irqoff_max[h] * (1000000000 / TIMEBASE_HZ));
+    print(", ");
+    print_num(16, irqoff_cause[h]);
+    print("\n");
+  }
+}
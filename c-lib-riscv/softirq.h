@@ -0,0 +1,50 @@
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// deferred interrupt work.
+//
+// the top half of a handler runs with interrupts off. it only claims,
+// acknowledges and queues work, everything else is done in a bottom half:
+//
+// * softirq_raise queues work on the current hart. it runs at the end of the
+//   outermost trap, with interrupts enabled again, right before sret.
+// * work_queue queues work on any hart. it runs in the hart's worker, the idle
+//   loop in main, and is meant for longer jobs like console commands. there
+//   are no ipis, so work for another hart waits for its next interrupt.
+
+typedef void (*work_fn)(size_t arg);
+
+struct work {
+  work_fn fn;
+  size_t arg;
+};
+
+// entries per hart and queue, must be a power of 2
+#define SOFTIRQ_QUEUE_SIZE (64)
+
+// returns 0, if the queue is full
+int softirq_raise(work_fn fn, size_t arg);
+
+// called by the trap handler on entry and on its way out. traps may nest,
+// the pending softirqs only run when leaving the outermost one
+void softirq_enter();
+void softirq_exit();
+
+// called right before interrupts are enabled again. records the time they
+// have been off since the trap was entered
+void softirq_irqon();
+
+// 1, while the calling hart is in a trap, in a top or a bottom half
+int softirq_in_trap();
+
+int work_queue(size_t hart, work_fn fn, size_t arg);
+int work_pending();
+void work_run();
+
+// print the worst case time with interrupts off, per hart
+void softirq_report();
+
+#endif
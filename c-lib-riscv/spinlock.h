@@ -0,0 +1,21 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include "atomic.h"
+
+struct spinlock {
+  volatile uint32_t locked;
+};
+
+static inline void spin_lock(struct spinlock *l) {
+  while (amoswap(&l->locked, 1))
+    // wait with plain loads, so the line is not bounced between harts
+    while (l->locked)
+      ;
+}
+
+static inline void spin_unlock(struct spinlock *l) {
+  store_release(&l->locked, 0);
+}
+
+#endif
@@ -0,0 +1,61 @@
+#include "stack.h"
+#include "board.h"
+#include "config.h"
+#include "console.h"
+#include "riscv.h"
+#include <stdint.h>
+
+// provided by the linker script
+extern char __STACKS_BEGIN__[];
+
+static uint32_t *slot(size_t hart) {
+  return (uint32_t *)(__STACKS_BEGIN__ + hart * STACK_SLOT);
+}
+
+size_t stack_used(size_t hart) {
+  uint32_t *w = slot(hart) + STACK_GUARD / 4;
+  uint32_t *top = slot(hart + 1);
+
+  while (w < top && *w == STACK_CANARY)
+    w++;
+  return (top - w) * 4;
+}
+
+int stack_guard_intact(size_t hart) {
+  uint32_t *guard = slot(hart);
+
+  for (size_t i = 0; i < STACK_GUARD / 4; i++)
+    if (guard[i] != STACK_CANARY)
+      return 0;
+  return 1;
+}
+
+void stack_check() {
+  // the word right below the stack is the first one an overflow hits
+  if (slot(hartid())[STACK_GUARD / 4 - 1] != STACK_CANARY)
+    stack_overflow();
+}
+
+void stack_overflow() {
+  print("stack: hart ");
+  print_num(10, hartid());
+  print(" overflowed its stack\n");
+
+  while (1)
+    ;
+}
+
+void stack_report() {
+  print("stacks: hart, used, size\n");
+  for (size_t h = 0; h < board.harts; h++) {
+    print("  ");
+    print_num(10, h);
+    print(", ");
+    print_num(10, stack_used(h));
+    print(", ");
+    print_num(10, STACK_SIZE);
+    if (!stack_guard_intact(h))
+      print(", overflowed");
+    print("\n");
+  }
+}
@@ -0,0 +1,33 @@
+#ifndef STACK_H
+#define STACK_H
+
+#include <stddef.h>
+
+// the per-hart stacks, see config.h for the sizes.
+//
+// each hart has an aligned slot at the end of the kernel image. the lowest
+// page of the slot is a guard page, the stack grows down towards it. crt0
+// paints the whole slot with STACK_CANARY, so the high-water mark is the
+// lowest word, which does not hold the canary anymore.
+//
+// overflows are caught two ways. the kernel page table leaves the guard pages
+// unmapped, so while a process runs, an overflow faults, and the trap entry
+// notices that its frame would land in the guard page. in bare mode, nothing
+// faults, but each trap checks the word below the stack.
+
+// bytes of the stack a hart touched so far
+size_t stack_used(size_t hart);
+
+// 0, if the hart wrote to its guard page
+int stack_guard_intact(size_t hart);
+
+// halts the calling hart, if it ran into its guard page
+void stack_check();
+
+// called from the trap entry, on the top of the overflowed stack
+void stack_overflow() __attribute__((noreturn));
+
+// high-water marks of all harts
+void stack_report();
+
+#endif
@@ -0,0 +1,42 @@
+#include "syscall.h"
+#include "console.h"
+#include "proc.h"
+#include "riscv.h"
+#include "vm.h"
+
+static uint64_t sys_exit(SYSCALL_ARGS) { proc_exit(a0); }
+
+// the console may hand the buffer to a device, which only sees physical
+// addresses. copy it out in chunks
+static uint64_t sys_write(SYSCALL_ARGS) {
+  const char *buf = (const char *)a0;
+  size_t len = a1;
+  char chunk[128];
+
+  if (!vm_check(&proc_current()->vm, (uintptr_t)buf, len, PTE_R))
+    return (size_t)SYS_EFAULT;
+
+  for (size_t done = 0; done < len;) {
+    size_t n = len - done < sizeof(chunk) ? len - done : sizeof(chunk);
+    for (size_t i = 0; i < n; i++)
+      chunk[i] = buf[done + i];
+    console_write(chunk, n);
+    done += n;
+  }
+
+  return len;
+}
+
+static uint64_t sys_null(SYSCALL_ARGS) { return 0; }
+
+static uint64_t sys_time(SYSCALL_ARGS) { return rdtime(); }
+
+static uint64_t sys_hartid(SYSCALL_ARGS) { return hartid(); }
+
+const syscall_fn syscall_table[SYS_COUNT] = {
+    [SYS_EXIT] = sys_exit,
+    [SYS_WRITE] = sys_write,
+    [SYS_NULL] = sys_null,
+    [SYS_TIME] = sys_time,
+    [SYS_HARTID] = sys_hartid,
+};
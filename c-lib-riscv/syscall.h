@@ -0,0 +1,41 @@
+#ifndef SYSCALL_H
+#define SYSCALL_H
+
+// system calls are made with ecall. the number is passed in a7, up to 6
+// arguments in a0-a5, and the result is returned in a0, and a1 for 64 bit
+// values. like a function call, t0-t6 and a1-a7 are clobbered, everything
+// else is preserved.
+//
+// trap_direct dispatches them without saving a full frame, only ra, sp, gp
+// and tp are replaced by the kernel's, the rest is left to the calling
+// convention of the handlers. handlers run with interrupts off and must be
+// short. they may fault on user memory, the access is allowed by SUM.
+//
+// user programs use the same numbers, in user/sys.h
+#define SYS_EXIT (0)
+#define SYS_WRITE (1)
+#define SYS_NULL (2)
+#define SYS_TIME (3)
+#define SYS_HARTID (4)
+#define SYS_COUNT (5)
+
+// unknown system calls return -1, a buffer that is not mapped with the
+// access the call needs -2
+#define SYS_ENOSYS (-1)
+#define SYS_EFAULT (-2)
+
+// the numbers are used by trap.S as well
+#ifndef __ASSEMBLER__
+#include <stddef.h>
+#include <stdint.h>
+
+#define SYSCALL_ARGS                                                           \
+  size_t a0, size_t a1, size_t a2, size_t a3, size_t a4, size_t a5
+
+typedef uint64_t (*syscall_fn)(SYSCALL_ARGS);
+
+// indexed by trap_direct
+extern const syscall_fn syscall_table[SYS_COUNT];
+#endif
+
+#endif
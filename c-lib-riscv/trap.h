@@ -0,0 +1,37 @@
+#ifndef TRAP_H
+#define TRAP_H
+
+#include <stddef.h>
+
+// the registers saved by trap_direct, in the order of their number, followed
+// by sepc and sstatus. 36 words keep sp 16 byte aligned
+struct trap_frame {
+  size_t ra, sp, gp, tp;
+  size_t t0, t1, t2;
+  size_t s0, s1;
+  size_t a0, a1, a2, a3, a4, a5, a6, a7;
+  size_t s2, s3, s4, s5, s6, s7, s8, s9, s10, s11;
+  size_t t3, t4, t5, t6;
+  size_t sepc, sstatus;
+  size_t pad[3];
+};
+
+// the kernel context saved by user_enter: ra, sp and s0-s11
+struct user_context {
+  size_t regs[14];
+};
+
+// implemented in trap.S
+
+void trap_direct();
+
+// drop to user mode at entry, with the stack pointer set to sp. the calling
+// hart runs the user code until user_return is called with the same context,
+// from a trap. user_enter then returns the value passed to user_return
+size_t user_enter(struct user_context *k, size_t entry, size_t sp);
+void user_return(struct user_context *k, size_t value)
+    __attribute__((noreturn));
+
+void trap_zero(struct trap_frame *f);
+
+#endif
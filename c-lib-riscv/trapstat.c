@@ -0,0 +1,109 @@
+#include "trapstat.h"
+#include "config.h"
+#include "console.h"
+#include "mem.h"
+#include "plic.h"
+#include "riscv.h"
+
+struct cause_stats {
+  uint32_t count;
+  uint32_t hist[TRAPSTAT_BUCKETS];
+};
+
+struct source_stats {
+  uint32_t count;
+  uint64_t cycles;
+};
+
+struct hart_stats {
+  // interrupts, then exceptions
+  struct cause_stats causes[2][TRAPSTAT_CAUSES];
+  struct source_stats sources[PLIC_NUM_SOURCES];
+};
+
+static struct hart_stats stats[MAX_HARTS];
+
+static inline size_t bucket(uint32_t cycles) {
+  size_t b = cycles ? 31 - __builtin_clz(cycles) : 0;
+  return b < TRAPSTAT_BUCKETS ? b : TRAPSTAT_BUCKETS - 1;
+}
+
+void trapstat_trap(size_t cause, uint32_t cycles) {
+  int interrupt = cause >> 31;
+  size_t code = cause & 0x7fffffff;
+  if (code >= TRAPSTAT_CAUSES)
+    return;
+
+  struct cause_stats *s = &stats[hartid()].causes[!interrupt][code];
+  s->count++;
+  s->hist[bucket(cycles)]++;
+}
+
+void trapstat_irq(size_t src, uint32_t cycles) {
+  if (src >= PLIC_NUM_SOURCES)
+    return;
+
+  struct source_stats *s = &stats[hartid()].sources[src];
+  s->count++;
+  s->cycles += cycles;
+}
+
+static const char *cause_name(int exception, size_t code) {
+  const char *name = NULL;
+  if (!exception && code < sizeof(irq_names) / sizeof(*irq_names))
+    name = irq_names[code];
+  if (exception && code < sizeof(exception_names) / sizeof(*exception_names))
+    name = exception_names[code];
+  return name ? name : "unknown";
+}
+
+void trapstat_report() {
+  print("traps: hart, cause, count, log2 cycles:count\n");
+  for (size_t h = 0; h < board.harts; h++) {
+    for (int e = 0; e < 2; e++) {
+      for (size_t c = 0; c < TRAPSTAT_CAUSES; c++) {
+        struct cause_stats *s = &stats[h].causes[e][c];
+        if (!s->count)
+          continue;
+
+        print("  ");
+        print_num(10, h);
+        print(", ");
+        print(cause_name(e, c));
+        print(", ");
+        print_num(10, s->count);
+        print(",");
+        for (size_t b = 0; b < TRAPSTAT_BUCKETS; b++) {
+          if (!s->hist[b])
+            continue;
+          print(" ");
+          print_num(10, b);
+          print(":");
+          print_num(10, s->hist[b]);
+        }
+        print("\n");
+      }
+    }
+  }
+
+  print("irqs: hart, plic source, count, avg cycles\n");
+  for (size_t h = 0; h < board.harts; h++) {
+    for (size_t src = 1; src < PLIC_NUM_SOURCES; src++) {
+      struct source_stats *s = &stats[h].sources[src];
+      if (!s->count)
+        continue;
+
+      print("  ");
+      print_num(10, h);
+      print(", ");
+      print_num(10, src);
+      print(", ");
+      print_num(10, s->count);
+      print(", ");
+      print_num(10, s->cycles / s->count);
+      print("\n");
+    }
+  }
+}
+
+void trapstat_reset() { memset(stats, 0, sizeof(stats)); }
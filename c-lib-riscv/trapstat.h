@@ -0,0 +1,33 @@
+#ifndef TRAPSTAT_H
+#define TRAPSTAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// trap counters and handler durations, per hart.
+//
+// every trap is counted by its cause, every external interrupt by its plic
+// source. the duration of trap_zero, including the bottom halves it ran, goes
+// into a log2 histogram of cycles per cause: bucket i counts durations in
+// [2^i, 2^(i+1)), the last one everything longer. a nested trap is part of
+// the duration of the trap it interrupted.
+//
+// each hart only writes its own counters, so they are not locked. a report
+// may see them in the middle of an update.
+
+#define TRAPSTAT_CAUSES (16)
+#define TRAPSTAT_BUCKETS (24)
+
+// the whole trap, cause is the value of scause on entry
+void trapstat_trap(size_t cause, uint32_t cycles);
+
+// the top half of a plic source
+void trapstat_irq(size_t src, uint32_t cycles);
+
+// nonzero counters and histograms of all harts
+void trapstat_report();
+
+// zero the counters of all harts
+void trapstat_reset();
+
+#endif
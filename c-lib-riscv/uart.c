@@ -0,0 +1,76 @@
+#include "uart.h"
+#include "plic.h"
+#include "riscv.h"
+#include "waitq.h"
+
+static void tx_arm(struct wait_queue *wq);
+
+static struct wait_queue tx_wait = {
+    .name = "uart tx",
+    .arm = tx_arm,
+};
+
+static volatile struct UartLSR *lsr() {
+  return (volatile struct UartLSR *)(UART_BASE + UART_LSR);
+}
+
+static volatile uint8_t *reg(size_t off) {
+  return (volatile uint8_t *)(UART_BASE + off);
+}
+
+// the interrupt is level triggered, it stays on while there is room. the top
+// half switches it off again
+static void tx_arm(struct wait_queue *wq) {
+  *reg(UART_IER) |= UART_IER_TX_EMPTY;
+}
+
+void uart_init(size_t hart) {
+  *reg(UART_FCR) |= UART_FCR_ENABLE_FIFO | UART_FCR_CLEAR_RX |
+                    UART_FCR_CLEAR_TX | UART_FCR_TRIGGER_8b;
+
+  *reg(UART_LCR) |= UART_LCR_WORD_LEN_8b;
+
+  *reg(UART_IER) |= UART_IER_RX_AVAIL;
+
+  plic_enable(PLIC_SRC_UART, hart);
+  tx_wait.harts = 1 << hart;
+}
+
+void uart_write(const char c) {
+  wait_event(&tx_wait, lsr()->empty_thr, UART_TX_SPIN_NS);
+
+  *reg(UART_THR) = c;
+
+  if (c == '\n')
+    uart_write('\r');
+}
+
+char uart_read() {
+  char c = *reg(UART_RBR);
+
+  if (c == '\r')
+    c = '\n';
+
+  return c;
+}
+
+int uart_rx_ready() { return lsr()->data_ready; }
+
+void uart_flush() {
+  wait_event(&tx_wait, lsr()->empty_thr, UART_TX_SPIN_NS);
+
+  // the shift register drains within a character, there is no interrupt for
+  // it
+  while (!lsr()->empty_dhr)
+    ;
+}
+
+void uart_tx_irq() {
+  if (!(*reg(UART_IER) & UART_IER_TX_EMPTY) || !lsr()->empty_thr)
+    return;
+
+  *reg(UART_IER) &= ~UART_IER_TX_EMPTY;
+  wake_up(&tx_wait);
+}
+
+void uart_report() { wait_report(&tx_wait); }
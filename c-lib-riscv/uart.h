@@ -0,0 +1,35 @@
+#ifndef UART_H
+#define UART_H
+
+#include <stddef.h>
+
+// the 16550 console uart. writers wait for room in the transmitter on a wait
+// queue, see waitq.h. they spin for UART_TX_SPIN_NS first, at 115200 baud a
+// character takes about 87us. input is interrupt driven, the top half drains
+// the receiver.
+
+#define UART_TX_SPIN_NS (20000)
+
+// enable the fifos and the receive interrupt, and route the uart to the hart.
+// only that hart parks, writers on other harts spin
+void uart_init(size_t hart);
+
+// wait for the transmitter, and write a character. a newline is followed by a
+// carriage return
+void uart_write(const char c);
+
+// read a character, once uart_rx_ready. a carriage return reads as newline
+char uart_read();
+
+int uart_rx_ready();
+
+// wait until the transmitter is idle, the last character is out
+void uart_flush();
+
+// from the top half. ends the wait of the writers, once there is room
+void uart_tx_irq();
+
+// the wait queue of the writers
+void uart_report();
+
+#endif
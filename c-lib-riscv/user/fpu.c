@@ -0,0 +1,61 @@
+// the lazy fpu: the registers read 0 on the first use, even if a previous
+// program left values behind, and survive a system call and page faults. the
+// exit status is the number of registers that did not. run it twice, the
+// second run checks that nothing leaks from the first
+
+#include "sys.h"
+
+#define EACH(m)                                                                \
+  m(0) m(1) m(2) m(3) m(4) m(5) m(6) m(7) m(8) m(9) m(10) m(11) m(12) m(13)    \
+      m(14) m(15) m(16) m(17) m(18) m(19) m(20) m(21) m(22) m(23) m(24) m(25)  \
+          m(26) m(27) m(28) m(29) m(30) m(31)
+
+#define FLD(n) "fld f" #n ", " #n "*8(%[in])\n"
+#define FSD(n) "fsd f" #n ", " #n "*8(%[out])\n"
+
+static const char msg[] = "fpu: registers loaded, across a system call\n";
+
+// a page each, they are mapped on demand. the stores fault with the fpu on
+static uint64_t first[512], loaded[512], after[512];
+
+static void print(const char *s) {
+  size_t n = 0;
+  while (s[n])
+    n++;
+  write(s, n);
+}
+
+static size_t differ(const uint64_t *a, const uint64_t *b) {
+  size_t n = 0;
+  for (int i = 0; i < 32; i++)
+    n += a[i] != b[i];
+  return n;
+}
+
+int main() {
+  uint64_t zero[32] = {0};
+  uint32_t fcsr;
+
+  // the first fp instruction traps, the kernel hands out a clean bank
+  asm volatile(EACH(FSD) "frcsr %[fcsr]\n"
+               : [fcsr] "=r"(fcsr)
+               : [out] "r"(first)
+               : "memory");
+
+  for (int i = 0; i < 32; i++)
+    loaded[i] = 0x3ff0000000000000ull + ((uint64_t)i << 32) + i;
+
+  // load a pattern, and keep it in the registers over the call
+  register size_t a0 asm("a0") = (size_t)msg;
+  register size_t a1 asm("a1") = sizeof(msg) - 1;
+  register size_t a7 asm("a7") = SYS_WRITE;
+  asm volatile(EACH(FLD) "ecall\n" EACH(FSD)
+               : "+r"(a0), "+r"(a1), "+r"(a7)
+               : [in] "r"(loaded), [out] "r"(after)
+               : "t0", "t1", "t2", "t3", "t4", "t5", "t6", "a2", "a3", "a4",
+                 "a5", "a6", "memory");
+
+  size_t bad = differ(first, zero) + (fcsr != 0) + differ(after, loaded);
+  print(bad ? "fpu: registers lost or leaked\n" : "fpu: ok\n");
+  return bad;
+}
@@ -0,0 +1,68 @@
+// system call latency: a null call, and the time and hart id, both with a
+// call and through the vdso page
+
+#include "sys.h"
+
+#define ROUNDS (10000)
+
+static void print(const char *s) {
+  size_t n = 0;
+  while (s[n])
+    n++;
+  write(s, n);
+}
+
+static void print_num(uint32_t v) {
+  char buf[12];
+  char *p = buf + sizeof(buf);
+  *--p = '\0';
+  do {
+    *--p = '0' + v % 10;
+    v /= 10;
+  } while (v);
+  print(p);
+}
+
+// per round, in ns. a run takes well below 2^32 ns
+static void report(const char *name, uint64_t ticks) {
+  print("  ");
+  print(name);
+  print(", ns ");
+  print_num((uint32_t)ticks * vdso->ns_per_tick / ROUNDS);
+  print("\n");
+}
+
+int main() {
+  uint64_t start, sink = 0;
+
+  print("nullcall: per call, on hart ");
+  print_num(hartid());
+  print("\n");
+
+  start = rdtime();
+  for (int i = 0; i < ROUNDS; i++)
+    syscall(SYS_NULL, 0, 0);
+  report("null syscall", rdtime() - start);
+
+  start = rdtime();
+  for (int i = 0; i < ROUNDS; i++)
+    sink += syscall(SYS_TIME, 0, 0);
+  report("time syscall", rdtime() - start);
+
+  start = rdtime();
+  for (int i = 0; i < ROUNDS; i++)
+    sink += uptime_ns();
+  report("time vdso", rdtime() - start);
+
+  start = rdtime();
+  for (int i = 0; i < ROUNDS; i++)
+    sink += syscall(SYS_HARTID, 0, 0);
+  report("hartid syscall", rdtime() - start);
+
+  start = rdtime();
+  for (int i = 0; i < ROUNDS; i++)
+    sink += hartid();
+  report("hartid vdso", rdtime() - start);
+
+  return sink == 0;
+}
@@ -0,0 +1,23 @@
+// touches a few pages of each kind: text, read-only data, data written
+// through copy-on-write, and .bss. the exit status is a checksum
+
+static const unsigned table[1024] = {1, 2, 3, 4};
+static unsigned data[2048] = {5, 6, 7, 8};
+static unsigned bss[4096];
+
+int main() {
+  unsigned sum = 0;
+
+  for (int i = 0; i < 4; i++)
+    sum += table[i] + data[i];
+
+  // one write per page, the rest of the pages stay shared
+  data[1024] = sum;
+  for (int i = 0; i < 4096; i += 1024)
+    bss[i] = i;
+
+  for (int i = 0; i < 4096; i += 1024)
+    sum += bss[i];
+
+  return sum + data[1024];
+}
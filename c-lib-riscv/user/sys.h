@@ -0,0 +1,72 @@
+#ifndef SYS_H
+#define SYS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// the system calls and the vdso page of the kernel, see syscall.h and
+// vdso.h there
+
+#define SYS_EXIT (0)
+#define SYS_WRITE (1)
+#define SYS_NULL (2)
+#define SYS_TIME (3)
+#define SYS_HARTID (4)
+
+#define SYS_ENOSYS (-1)
+#define SYS_EFAULT (-2)
+
+// like a call, t0-t6 and a1-a7 are clobbered
+static inline uint64_t syscall(size_t n, size_t a0, size_t a1) {
+  register size_t r0 asm("a0") = a0;
+  register size_t r1 asm("a1") = a1;
+  register size_t r7 asm("a7") = n;
+  asm volatile("ecall"
+               : "+r"(r0), "+r"(r1), "+r"(r7)
+               :
+               : "t0", "t1", "t2", "t3", "t4", "t5", "t6", "a2", "a3", "a4",
+                 "a5", "a6", "memory");
+  return r0 | (uint64_t)r1 << 32;
+}
+
+static inline void exit(size_t status) {
+  syscall(SYS_EXIT, status, 0);
+  __builtin_unreachable();
+}
+
+static inline size_t write(const char *buf, size_t len) {
+  return syscall(SYS_WRITE, (size_t)buf, len);
+}
+
+#define VDSO_BASE (0x02000000 - 4096)
+
+struct vdso_data {
+  uint32_t version;
+  uint32_t hart;
+  uint32_t harts;
+  uint32_t timebase_hz;
+  uint32_t ns_per_tick;
+  uint32_t reserved;
+  uint64_t boot_time;
+};
+
+#define vdso ((const volatile struct vdso_data *)VDSO_BASE)
+
+static inline uint64_t rdtime() {
+  uint32_t hi, lo, tmp;
+  do {
+    asm volatile("csrr %0, timeh" : "=r"(hi));
+    asm volatile("csrr %0, time" : "=r"(lo));
+    asm volatile("csrr %0, timeh" : "=r"(tmp));
+  } while (hi != tmp);
+  return ((uint64_t)hi << 32) | lo;
+}
+
+// no trap for either
+static inline uint64_t uptime_ns() {
+  return (rdtime() - vdso->boot_time) * vdso->ns_per_tick;
+}
+
+static inline uint32_t hartid() { return vdso->hart; }
+
+#endif
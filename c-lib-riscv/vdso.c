@@ -0,0 +1,24 @@
+#include "vdso.h"
+#include "config.h"
+#include "page.h"
+#include "riscv.h"
+
+static struct vdso_data *pages[MAX_HARTS];
+
+void vdso_init() {
+  uint64_t boot_time = rdtime();
+
+  for (size_t i = 0; i < board.harts; i++) {
+    pages[i] = page_alloc();
+    *pages[i] = (struct vdso_data){
+        .version = VDSO_VERSION,
+        .hart = i,
+        .harts = board.harts,
+        .timebase_hz = TIMEBASE_HZ,
+        .ns_per_tick = 1000000000 / TIMEBASE_HZ,
+        .boot_time = boot_time,
+    };
+  }
+}
+
+void *vdso_page() { return pages[hartid()]; }
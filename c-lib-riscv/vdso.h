@@ -0,0 +1,36 @@
+#ifndef VDSO_H
+#define VDSO_H
+
+#include <stdint.h>
+
+// a read-only page mapped into every process, at the top of the user range.
+// it answers what would otherwise be system calls: the time is read from the
+// time csr, which user mode may read, and converted with the time base from
+// this page. the hart id comes from the page itself, every hart has its own,
+// and a process maps the one of the hart it runs on. processes dont migrate
+// yet, once they do, the page has to be switched with them.
+//
+// user programs see the same layout, in user/sys.h
+
+#define VDSO_VERSION (1)
+
+struct vdso_data {
+  uint32_t version;
+  uint32_t hart;
+  // harts of the board
+  uint32_t harts;
+  uint32_t timebase_hz;
+  // exact, if the time base divides 1 GHz
+  uint32_t ns_per_tick;
+  uint32_t reserved;
+  // time csr, once the kernel was up
+  uint64_t boot_time;
+};
+
+// fill in the pages of all harts. called once, after page_init
+void vdso_init();
+
+// the page of the calling hart
+void *vdso_page();
+
+#endif
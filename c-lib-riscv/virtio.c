@@ -0,0 +1,237 @@
+#include "virtio.h"
+#include "atomic.h"
+#include "mem.h"
+#include "page.h"
+#include "riscv.h"
+
+#define AVAIL_OFFSET (1024)
+#define USED_OFFSET (2048)
+
+// 2.7.10 Driver and Device Event Suppression. true, if the other side asked
+// to be notified, once the index moved past event
+static inline int need_event(uint16_t event, uint16_t new, uint16_t old) {
+  return (uint16_t)(new - event - 1) < (uint16_t)(new - old);
+}
+
+static inline volatile uint16_t *used_event(struct virtq *q) {
+  return &q->avail->ring[VIRTQ_NUM];
+}
+
+static inline volatile uint16_t *avail_event(struct virtq *q) {
+  return (volatile uint16_t *)&q->used->ring[VIRTQ_NUM];
+}
+
+int virtio_find(uint32_t id, size_t nth, struct virtio_dev *dev) {
+  for (size_t i = 0; i < board.nvirtio; i++) {
+    dev->base = board.virtio[i].base;
+    dev->irq = board.virtio[i].irq;
+
+    if (*virtio_reg(dev, VIRTIO_MMIO_MAGIC_VALUE) != VIRTIO_MAGIC ||
+        *virtio_reg(dev, VIRTIO_MMIO_VERSION) != 2)
+      continue;
+
+    dev->id = *virtio_reg(dev, VIRTIO_MMIO_DEVICE_ID);
+    if (dev->id == id && nth-- == 0)
+      return 1;
+  }
+
+  return 0;
+}
+
+// 3.1.1 Driver Requirements: Device Initialization
+int virtio_init(struct virtio_dev *dev, uint64_t features) {
+  volatile uint32_t *status = virtio_reg(dev, VIRTIO_MMIO_STATUS);
+
+  *status = 0;
+  *status |= VIRTIO_STATUS_ACKNOWLEDGE;
+  *status |= VIRTIO_STATUS_DRIVER;
+
+  features |= VIRTIO_F_VERSION_1;
+
+  uint64_t offered = 0;
+  for (uint32_t sel = 0; sel < 2; sel++) {
+    *virtio_reg(dev, VIRTIO_MMIO_DEVICE_FEATURES_SEL) = sel;
+    offered |= (uint64_t)*virtio_reg(dev, VIRTIO_MMIO_DEVICE_FEATURES)
+               << (32 * sel);
+  }
+
+  dev->features = features & offered;
+
+  for (uint32_t sel = 0; sel < 2; sel++) {
+    *virtio_reg(dev, VIRTIO_MMIO_DRIVER_FEATURES_SEL) = sel;
+    *virtio_reg(dev, VIRTIO_MMIO_DRIVER_FEATURES) = dev->features >> (32 * sel);
+  }
+
+  *status |= VIRTIO_STATUS_FEATURES_OK;
+  if (!(*status & VIRTIO_STATUS_FEATURES_OK)) {
+    *status |= VIRTIO_STATUS_FAILED;
+    return 0;
+  }
+
+  return 1;
+}
+
+int virtq_init(struct virtio_dev *dev, struct virtq *q, uint32_t index) {
+  *virtio_reg(dev, VIRTIO_MMIO_QUEUE_SEL) = index;
+
+  if (*virtio_reg(dev, VIRTIO_MMIO_QUEUE_READY) ||
+      *virtio_reg(dev, VIRTIO_MMIO_QUEUE_NUM_MAX) < VIRTQ_NUM)
+    return 0;
+
+  uint8_t *page = page_alloc();
+  if (!page)
+    return 0;
+
+  memset(q, 0, sizeof(*q));
+  q->dev = dev;
+  q->index = index;
+  q->desc = (struct virtq_desc *)page;
+  q->avail = (struct virtq_avail *)(page + AVAIL_OFFSET);
+  q->used = (struct virtq_used *)(page + USED_OFFSET);
+
+  // chain all descriptors into the free list
+  for (uint16_t i = 0; i < VIRTQ_NUM; i++)
+    q->desc[i].next = i + 1;
+  q->num_free = VIRTQ_NUM;
+
+  uintptr_t desc = (uintptr_t)q->desc;
+  uintptr_t avail = (uintptr_t)q->avail;
+  uintptr_t used = (uintptr_t)q->used;
+
+  *virtio_reg(dev, VIRTIO_MMIO_QUEUE_NUM) = VIRTQ_NUM;
+  *virtio_reg(dev, VIRTIO_MMIO_QUEUE_DESC_LOW) = desc;
+  *virtio_reg(dev, VIRTIO_MMIO_QUEUE_DESC_HIGH) = 0;
+  *virtio_reg(dev, VIRTIO_MMIO_QUEUE_DRIVER_LOW) = avail;
+  *virtio_reg(dev, VIRTIO_MMIO_QUEUE_DRIVER_HIGH) = 0;
+  *virtio_reg(dev, VIRTIO_MMIO_QUEUE_DEVICE_LOW) = used;
+  *virtio_reg(dev, VIRTIO_MMIO_QUEUE_DEVICE_HIGH) = 0;
+  *virtio_reg(dev, VIRTIO_MMIO_QUEUE_READY) = 1;
+
+  return 1;
+}
+
+void virtio_ready(struct virtio_dev *dev) {
+  *virtio_reg(dev, VIRTIO_MMIO_STATUS) |= VIRTIO_STATUS_DRIVER_OK;
+}
+
+uint32_t virtio_ack(struct virtio_dev *dev) {
+  uint32_t status = *virtio_reg(dev, VIRTIO_MMIO_INTERRUPT_STATUS);
+  *virtio_reg(dev, VIRTIO_MMIO_INTERRUPT_ACK) = status;
+  return status;
+}
+
+int virtq_add(struct virtq *q, const struct virtq_buf *bufs, size_t out,
+              size_t in, void *cookie) {
+  size_t n = out + in;
+  if (!n || n > q->num_free)
+    return 0;
+
+  uint16_t head = q->free_head;
+  uint16_t i = head, last = head;
+
+  for (size_t k = 0; k < n; k++) {
+    struct virtq_desc *d = &q->desc[i];
+    d->addr = (uintptr_t)bufs[k].addr;
+    d->len = bufs[k].len;
+    d->flags = (k < out ? 0 : VIRTQ_DESC_F_WRITE) |
+               (k + 1 < n ? VIRTQ_DESC_F_NEXT : 0);
+    last = i;
+    i = d->next;
+  }
+
+  // the last descriptor still links into the free list, remember where it
+  // continues
+  q->free_head = q->desc[last].next;
+  q->num_free -= n;
+  q->inflight++;
+  q->cookie[head] = cookie;
+
+  q->avail->ring[q->avail_idx % VIRTQ_NUM] = head;
+  q->avail_idx++;
+
+  return 1;
+}
+
+int virtq_kick(struct virtq *q) {
+  uint16_t old = q->kicked;
+  uint16_t new = q->avail_idx;
+  int pending = 0;
+
+  if (old == new)
+    return 0;
+
+  // the ring entries must be visible, before the index is
+  fence;
+  ((volatile struct virtq_avail *)q->avail)->idx = new;
+  q->kicked = new;
+
+  if (!q->polling)
+    pending = virtq_arm(q);
+
+  // and the index must be visible, before the device's event is read
+  fence;
+
+  int notify;
+  if (q->dev->features & VIRTIO_F_EVENT_IDX)
+    notify = need_event(*avail_event(q), new, old);
+  else
+    notify = !(((volatile struct virtq_used *)q->used)->flags & 1);
+
+  if (notify)
+    *virtio_reg(q->dev, VIRTIO_MMIO_QUEUE_NOTIFY) = q->index;
+
+  return pending;
+}
+
+void *virtq_get(struct virtq *q, uint32_t *len) {
+  if (q->last_used == ((volatile struct virtq_used *)q->used)->idx)
+    return NULL;
+
+  // read the entry only after the index
+  fence;
+
+  struct virtq_used_elem *e = &q->used->ring[q->last_used % VIRTQ_NUM];
+  uint16_t head = e->id;
+  if (len)
+    *len = e->len;
+  q->last_used++;
+  q->inflight--;
+
+  // return the chain to the free list
+  uint16_t i = head;
+  q->num_free++;
+  while (q->desc[i].flags & VIRTQ_DESC_F_NEXT) {
+    i = q->desc[i].next;
+    q->num_free++;
+  }
+  q->desc[i].next = q->free_head;
+  q->free_head = head;
+
+  void *cookie = q->cookie[head];
+  q->cookie[head] = NULL;
+  return cookie;
+}
+
+void virtq_poll_mode(struct virtq *q, int polling) {
+  q->polling = polling;
+
+  if (polling) {
+    // without event idx, the flag is the only hint. with it, move the event
+    // as far away as possible
+    q->avail->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+    *used_event(q) = q->last_used - 1;
+  } else {
+    q->avail->flags = 0;
+    virtq_arm(q);
+  }
+
+  fence;
+}
+
+int virtq_arm(struct virtq *q) {
+  uint16_t batch = q->inflight / 2 ? q->inflight / 2 : 1;
+  *used_event(q) = q->last_used + batch - 1;
+
+  fence;
+  return q->last_used != ((volatile struct virtq_used *)q->used)->idx;
+}
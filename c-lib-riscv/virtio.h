@@ -0,0 +1,178 @@
+#ifndef VIRTIO_H
+#define VIRTIO_H
+
+#include "spinlock.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Virtual I/O Device (VIRTIO) Version 1.2, 4.2 Virtio Over MMIO. only the
+// modern interface (version 2) is supported. qemu needs
+// `-global virtio-mmio.force-legacy=false` for it.
+
+#define VIRTIO_MMIO_MAGIC_VALUE 0x000 // 0x74726976 ("virt")
+#define VIRTIO_MMIO_VERSION 0x004
+#define VIRTIO_MMIO_DEVICE_ID 0x008
+#define VIRTIO_MMIO_VENDOR_ID 0x00c
+#define VIRTIO_MMIO_DEVICE_FEATURES 0x010
+#define VIRTIO_MMIO_DEVICE_FEATURES_SEL 0x014
+#define VIRTIO_MMIO_DRIVER_FEATURES 0x020
+#define VIRTIO_MMIO_DRIVER_FEATURES_SEL 0x024
+#define VIRTIO_MMIO_QUEUE_SEL 0x030
+#define VIRTIO_MMIO_QUEUE_NUM_MAX 0x034
+#define VIRTIO_MMIO_QUEUE_NUM 0x038
+#define VIRTIO_MMIO_QUEUE_READY 0x044
+#define VIRTIO_MMIO_QUEUE_NOTIFY 0x050
+#define VIRTIO_MMIO_INTERRUPT_STATUS 0x060
+#define VIRTIO_MMIO_INTERRUPT_ACK 0x064
+#define VIRTIO_MMIO_STATUS 0x070
+#define VIRTIO_MMIO_QUEUE_DESC_LOW 0x080
+#define VIRTIO_MMIO_QUEUE_DESC_HIGH 0x084
+#define VIRTIO_MMIO_QUEUE_DRIVER_LOW 0x090
+#define VIRTIO_MMIO_QUEUE_DRIVER_HIGH 0x094
+#define VIRTIO_MMIO_QUEUE_DEVICE_LOW 0x0a0
+#define VIRTIO_MMIO_QUEUE_DEVICE_HIGH 0x0a4
+#define VIRTIO_MMIO_CONFIG 0x100
+
+#define VIRTIO_MAGIC (0x74726976)
+
+#define VIRTIO_ID_BLOCK (2)
+#define VIRTIO_ID_CONSOLE (3)
+
+// 2.1 Device Status Field
+#define VIRTIO_STATUS_ACKNOWLEDGE (1)
+#define VIRTIO_STATUS_DRIVER (2)
+#define VIRTIO_STATUS_DRIVER_OK (4)
+#define VIRTIO_STATUS_FEATURES_OK (8)
+#define VIRTIO_STATUS_FAILED (128)
+
+// 6 Reserved Feature Bits
+#define VIRTIO_F_INDIRECT_DESC (1ull << 28)
+#define VIRTIO_F_EVENT_IDX (1ull << 29)
+#define VIRTIO_F_VERSION_1 (1ull << 32)
+
+// 2.7 Split Virtqueues
+
+#define VIRTQ_DESC_F_NEXT (1)
+#define VIRTQ_DESC_F_WRITE (2)
+
+#define VIRTQ_AVAIL_F_NO_INTERRUPT (1)
+
+struct virtq_desc {
+  uint64_t addr;
+  uint32_t len;
+  uint16_t flags;
+  uint16_t next;
+};
+
+// with VIRTIO_F_EVENT_IDX, the entry past the ring holds used_event
+struct virtq_avail {
+  uint16_t flags;
+  uint16_t idx;
+  uint16_t ring[];
+};
+
+struct virtq_used_elem {
+  uint32_t id;
+  uint32_t len;
+};
+
+// with VIRTIO_F_EVENT_IDX, the entry past the ring holds avail_event
+struct virtq_used {
+  uint16_t flags;
+  uint16_t idx;
+  struct virtq_used_elem ring[];
+};
+
+// the rings of a queue share a single page: the descriptors at 0, the
+// available ring at 1K and the used ring at 2K
+#define VIRTQ_NUM (64)
+
+struct virtq_buf {
+  void *addr;
+  uint32_t len;
+};
+
+struct virtio_dev {
+  uintptr_t base;
+  uint32_t id;
+  uint32_t irq;
+  uint64_t features;
+};
+
+struct virtq {
+  struct virtio_dev *dev;
+  uint32_t index;
+
+  struct virtq_desc *desc;
+  struct virtq_avail *avail;
+  struct virtq_used *used;
+
+  uint16_t free_head;
+  uint16_t num_free;
+  // chains added, but not yet harvested
+  uint16_t inflight;
+
+  // entries added to the available ring, but not yet published
+  uint16_t avail_idx;
+  // avail idx at the last notification
+  uint16_t kicked;
+  // next used entry to harvest
+  uint16_t last_used;
+
+  // interrupts are suppressed and completions are harvested by polling
+  uint16_t polling;
+
+  void *cookie[VIRTQ_NUM];
+  struct spinlock lock;
+};
+
+// find the nth device with the given id. returns 0, if there is none
+int virtio_find(uint32_t id, size_t nth, struct virtio_dev *dev);
+
+// reset the device and negotiate features. VIRTIO_F_VERSION_1 is always
+// requested. returns 0, if the device did not accept them
+int virtio_init(struct virtio_dev *dev, uint64_t features);
+
+// set up a queue. must be called between virtio_init and virtio_ready
+int virtq_init(struct virtio_dev *dev, struct virtq *q, uint32_t index);
+
+void virtio_ready(struct virtio_dev *dev);
+
+// read and acknowledge the interrupt status
+uint32_t virtio_ack(struct virtio_dev *dev);
+
+static inline volatile uint32_t *virtio_reg(struct virtio_dev *dev,
+                                            size_t off) {
+  return (volatile uint32_t *)(dev->base + off);
+}
+
+static inline volatile void *virtio_config(struct virtio_dev *dev) {
+  return (volatile void *)(dev->base + VIRTIO_MMIO_CONFIG);
+}
+
+// the queue operations below expect the caller to hold q->lock, with
+// interrupts off
+
+// add a chain of out buffers, read by the device, followed by in buffers,
+// written by the device. the chain is not visible to the device, until
+// virtq_kick. returns 0, if there are not enough free descriptors
+int virtq_add(struct virtq *q, const struct virtq_buf *bufs, size_t out,
+              size_t in, void *cookie);
+
+// publish all chains added since the last kick and notify the device, unless
+// it asked not to be notified. a batch costs a single notification. returns
+// the result of virtq_arm, or 0 in polling mode
+int virtq_kick(struct virtq *q);
+
+// harvest one used chain and return its cookie, or NULL if there is none
+void *virtq_get(struct virtq *q, uint32_t *len);
+
+// switch between interrupt driven and polled completion
+void virtq_poll_mode(struct virtq *q, int polling);
+
+// request an interrupt, once half of the chains in flight completed. this
+// coalesces completions of deep queues into fewer interrupts. returns 1, if
+// chains completed in the meantime, which the device wont interrupt for
+int virtq_arm(struct virtq *q);
+
+#endif
@@ -0,0 +1,264 @@
+#include "virtio_blk.h"
+#include "console.h"
+#include "page.h"
+#include "plic.h"
+#include "riscv.h"
+#include "softirq.h"
+
+static struct virtio_dev dev;
+static struct virtq vq;
+static int present;
+
+static void blk_irq(size_t src);
+static void blk_softirq(size_t arg);
+
+// completions are small and delay the submitter, so they may preempt the
+// console
+static struct irq_driver driver = {
+    .name = "virtio-blk",
+    .priority = 3,
+    .top = blk_irq,
+};
+
+int blk_init(size_t hart) {
+  if (!virtio_find(VIRTIO_ID_BLOCK, 0, &dev))
+    return 0;
+
+  if (!virtio_init(&dev, VIRTIO_F_EVENT_IDX) || !virtq_init(&dev, &vq, 0))
+    return 0;
+
+  virtio_ready(&dev);
+
+  driver.src = dev.irq;
+  plic_register(&driver);
+  plic_enable(dev.irq, hart);
+
+  present = 1;
+  return 1;
+}
+
+int blk_present() { return present; }
+
+uint64_t blk_capacity() {
+  volatile uint32_t *cfg = virtio_config(&dev);
+  return cfg[0] | (uint64_t)cfg[1] << 32;
+}
+
+size_t blk_submit(struct blk_req **reqs, size_t n) {
+  size_t queued = 0;
+
+  size_t sie = irq_save();
+  spin_lock(&vq.lock);
+
+  for (; queued < n; queued++) {
+    struct blk_req *r = reqs[queued];
+    struct virtq_buf bufs[BLK_MAX_SEGS + 2];
+
+    r->hdr.type = r->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    r->hdr.reserved = 0;
+    r->hdr.sector = r->sector;
+
+    // header, data segments and the status byte form one chain. the data
+    // is read by the device for writes, and written by it for reads
+    bufs[0] = (struct virtq_buf){&r->hdr, sizeof(r->hdr)};
+    for (size_t i = 0; i < r->nsegs; i++)
+      bufs[1 + i] = r->segs[i];
+    bufs[1 + r->nsegs] = (struct virtq_buf){(void *)&r->status, 1};
+
+    size_t out = r->write ? 1 + r->nsegs : 1;
+    size_t in = r->write ? 1 : r->nsegs + 1;
+    if (!virtq_add(&vq, bufs, out, in, r))
+      break;
+
+    // the device only sees the chain after the kick below. a request that
+    // did not fit is left as it was
+    r->done = 0;
+    r->status = 0xff;
+  }
+
+  int pending = virtq_kick(&vq);
+
+  spin_unlock(&vq.lock);
+  irq_restore(sie);
+
+  // completions the device wont interrupt for
+  if (pending)
+    blk_poll();
+
+  return queued;
+}
+
+void blk_poll() {
+  struct blk_req *done[VIRTQ_NUM];
+  size_t n = 0;
+
+  size_t sie = irq_save();
+  spin_lock(&vq.lock);
+
+  do {
+    struct blk_req *r;
+    while (n < VIRTQ_NUM && (r = virtq_get(&vq, NULL)))
+      done[n++] = r;
+  } while (n < VIRTQ_NUM && !vq.polling && virtq_arm(&vq));
+
+  spin_unlock(&vq.lock);
+  irq_restore(sie);
+
+  // callbacks run without the lock, they may submit new requests
+  for (size_t i = 0; i < n; i++) {
+    done[i]->done = 1;
+    if (done[i]->complete)
+      done[i]->complete(done[i]);
+  }
+
+  // the batch was full, there may be more
+  if (n == VIRTQ_NUM)
+    softirq_raise(blk_softirq, 0);
+}
+
+static void blk_softirq(size_t arg) { blk_poll(); }
+
+void blk_polling(int on) {
+  size_t sie = irq_save();
+  spin_lock(&vq.lock);
+  virtq_poll_mode(&vq, on);
+  spin_unlock(&vq.lock);
+  irq_restore(sie);
+}
+
+// the top half only acknowledges, the used ring is harvested in the bottom
+// half
+static void blk_irq(size_t src) {
+  virtio_ack(&dev);
+  softirq_raise(blk_softirq, 0);
+}
+
+void blk_wait(struct blk_req *r) {
+  while (!r->done) {
+    if (vq.polling) {
+      blk_poll();
+      continue;
+    }
+
+    // check again with interrupts off, or the completion could slip in
+    // between the check and wfi
+    size_t sie = irq_save();
+    if (!r->done)
+      wfi;
+    irq_restore(sie);
+  }
+}
+
+int blk_rw(uint64_t sector, void *buf, size_t len, int write) {
+  struct blk_req r = {
+      .sector = sector,
+      .write = write,
+      .nsegs = 1,
+      .segs = {{buf, len}},
+  };
+  struct blk_req *rp = &r;
+
+  if (!present || !blk_submit(&rp, 1))
+    return VIRTIO_BLK_S_IOERR;
+
+  blk_wait(&r);
+  return r.status;
+}
+
+// benchmark
+
+// a request takes a chain of 3 descriptors, header, data and status. the
+// ring holds that many at once
+#define BENCH_DEPTH_MAX (VIRTQ_NUM / 3)
+#define BENCH_REQS (2048)
+#define BENCH_SECTORS (PAGE_SIZE / BLK_SECTOR_SIZE)
+
+static volatile size_t bench_completed;
+
+static void bench_complete(struct blk_req *r) { bench_completed++; }
+
+static uint32_t lcg(uint32_t *seed) {
+  *seed = *seed * 1664525 + 1013904223;
+  return *seed;
+}
+
+static uint64_t bench_run(struct blk_req *reqs, size_t depth) {
+  struct blk_req *batch[BENCH_DEPTH_MAX];
+  uint64_t blocks = blk_capacity() / BENCH_SECTORS;
+  uint32_t seed = 1;
+  size_t issued = 0;
+
+  bench_completed = 0;
+  uint64_t start = rdtime();
+
+  for (size_t i = 0; i < depth; i++)
+    reqs[i].done = 1;
+
+  while (bench_completed < BENCH_REQS) {
+    // taken before the scan, so a completion during it skips the wfi below
+    size_t seen = bench_completed;
+    size_t n = 0;
+    for (size_t i = 0; i < depth && issued + n < BENCH_REQS; i++) {
+      if (!reqs[i].done)
+        continue;
+      reqs[i].sector = lcg(&seed) % blocks * BENCH_SECTORS;
+      batch[n++] = &reqs[i];
+    }
+
+    if (n)
+      issued += blk_submit(batch, n);
+
+    if (vq.polling) {
+      blk_poll();
+    } else {
+      size_t sie = irq_save();
+      if (bench_completed == seen)
+        wfi;
+      irq_restore(sie);
+    }
+  }
+
+  return rdtime() - start;
+}
+
+void blk_bench() {
+  static const size_t depths[] = {1, 2, 4, 8, 16, BENCH_DEPTH_MAX};
+  struct blk_req reqs[BENCH_DEPTH_MAX];
+
+  if (!present || blk_capacity() < BENCH_SECTORS) {
+    print("blk: no disk\n");
+    return;
+  }
+
+  for (size_t i = 0; i < BENCH_DEPTH_MAX; i++) {
+    reqs[i] = (struct blk_req){
+        .nsegs = 1,
+        .segs = {{page_alloc(), PAGE_SIZE}},
+        .complete = bench_complete,
+    };
+  }
+
+  print("blk: mode, depth, iops, KB/s\n");
+
+  for (int polling = 1; polling >= 0; polling--) {
+    blk_polling(polling);
+
+    for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+      uint64_t ticks = bench_run(reqs, depths[d]);
+      if (!ticks)
+        ticks = 1;
+      size_t iops = (uint64_t)BENCH_REQS * TIMEBASE_HZ / ticks;
+
+      print(polling ? "  poll, " : "  irq, ");
+      print_num(10, depths[d]);
+      print(", ");
+      print_num(10, iops);
+      print(", ");
+      print_num(10, iops * (PAGE_SIZE / 1024));
+      print("\n");
+    }
+  }
+
+  for (size_t i = 0; i < BENCH_DEPTH_MAX; i++)
+    page_free(reqs[i].segs[0].addr);
+}
@@ -0,0 +1,67 @@
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+
+#include "virtio.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLK_SECTOR_SIZE (512)
+#define BLK_MAX_SEGS (4)
+
+// 5.2.6 Device Operation
+#define VIRTIO_BLK_T_IN (0)
+#define VIRTIO_BLK_T_OUT (1)
+
+#define VIRTIO_BLK_S_OK (0)
+#define VIRTIO_BLK_S_IOERR (1)
+#define VIRTIO_BLK_S_UNSUPP (2)
+
+struct virtio_blk_outhdr {
+  uint32_t type;
+  uint32_t reserved;
+  uint64_t sector;
+};
+
+// a request transfers its segments, in order, starting at sector. each
+// segment must be a multiple of the sector size. complete is called from the
+// bottom half, or from blk_poll in polling mode
+struct blk_req {
+  uint64_t sector;
+  int write;
+  size_t nsegs;
+  struct virtq_buf segs[BLK_MAX_SEGS];
+  void (*complete)(struct blk_req *r);
+  void *priv;
+
+  volatile uint32_t done;
+  struct virtio_blk_outhdr hdr;
+  volatile uint8_t status;
+};
+
+// probe the first virtio block device. returns 0, if there is none
+int blk_init(size_t hart);
+int blk_present();
+
+// capacity in sectors
+uint64_t blk_capacity();
+
+// queue a batch of requests with a single notification. returns the number
+// of requests queued, which is less than n if the queue filled up
+size_t blk_submit(struct blk_req **reqs, size_t n);
+
+// harvest completed requests. needed in polling mode, harmless otherwise
+void blk_poll();
+
+// suppress completion interrupts and rely on blk_poll instead
+void blk_polling(int on);
+
+// submit a single request and wait for it. returns the request status
+int blk_rw(uint64_t sector, void *buf, size_t len, int write);
+
+// wait for a request, submitted with blk_submit
+void blk_wait(struct blk_req *r);
+
+// measure iops and throughput for increasing queue depths
+void blk_bench();
+
+#endif
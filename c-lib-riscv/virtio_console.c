@@ -0,0 +1,69 @@
+#include "virtio_console.h"
+#include "riscv.h"
+
+static struct virtio_dev dev;
+static struct virtq tx;
+static int present;
+
+int vcon_init() {
+  if (!virtio_find(VIRTIO_ID_CONSOLE, 0, &dev))
+    return 0;
+
+  // the receive queue is left unused, the device only needs the queues the
+  // driver uses
+  if (!virtio_init(&dev, VIRTIO_F_EVENT_IDX) ||
+      !virtq_init(&dev, &tx, VCON_TXQ))
+    return 0;
+
+  // output is also written with interrupts off, from traps, so completions
+  // are always polled. qemu consumes the buffers during the notification
+  virtq_poll_mode(&tx, 1);
+
+  virtio_ready(&dev);
+
+  present = 1;
+  return 1;
+}
+
+int vcon_present() { return present; }
+
+// each chain carries a pointer to the count of buffers its writer still
+// waits for
+static void harvest() {
+  volatile uint32_t *left;
+  while ((left = virtq_get(&tx, NULL)))
+    (*left)--;
+}
+
+void vcon_writev(const struct virtq_buf *bufs, size_t n) {
+  volatile uint32_t left = 0;
+
+  size_t sie = irq_save();
+  spin_lock(&tx.lock);
+
+  for (size_t i = 0; i < n; i++) {
+    if (!bufs[i].len)
+      continue;
+
+    left++;
+    while (!virtq_add(&tx, &bufs[i], 1, 0, (void *)&left)) {
+      // the queue is full, publish what is queued and wait for room
+      virtq_kick(&tx);
+      harvest();
+    }
+  }
+
+  virtq_kick(&tx);
+
+  // the buffers belong to the caller again, only once the device is done
+  while (left)
+    harvest();
+
+  spin_unlock(&tx.lock);
+  irq_restore(sie);
+}
+
+void vcon_write(const void *buf, size_t len) {
+  struct virtq_buf b = {(void *)buf, len};
+  vcon_writev(&b, 1);
+}
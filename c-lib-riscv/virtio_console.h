@@ -0,0 +1,30 @@
+#ifndef VIRTIO_CONSOLE_H
+#define VIRTIO_CONSOLE_H
+
+#include "virtio.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// 5.3 Console Device. only output on port 0 is used, input stays on the
+// uart.
+//
+// buffers are handed to the device as they are, there is no copy into a
+// driver buffer. a write returns, once the device consumed the buffers, so
+// they may live on the stack. the device reads a whole buffer with a single
+// notification, the uart needs a status poll and a store per byte.
+
+// 5.3.2 Virtqueues, without VIRTIO_CONSOLE_F_MULTIPORT
+#define VCON_RXQ (0)
+#define VCON_TXQ (1)
+
+// probe the first virtio console. returns 0, if there is none
+int vcon_init();
+int vcon_present();
+
+void vcon_write(const void *buf, size_t len);
+
+// write several buffers, in order. they are queued together, with as few
+// notifications as the queue size allows
+void vcon_writev(const struct virtq_buf *bufs, size_t n);
+
+#endif
@@ -0,0 +1,342 @@
+#include "vm.h"
+#include "atomic.h"
+#include "config.h"
+#include "console.h"
+#include "mem.h"
+#include "page.h"
+#include "spinlock.h"
+
+#define MEGAPAGE_SIZE (0x400000)
+#define VPN1(va) ((uintptr_t)(va) >> 22)
+#define VPN0(va) (((uintptr_t)(va) >> 12) & 0x3ff)
+
+// provided by the linker script
+extern char __STACKS_BEGIN__[], __STACKS_END__[];
+
+// the kernel half of every root table
+static uint32_t *kernel_root;
+static void *zero_page;
+
+// file pages, copied for sharing, keyed by their source in the file. they
+// are never evicted, the files live in the initrd for the lifetime of the
+// kernel anyway
+#define SHARED_MAX (1024)
+
+static struct {
+  const uint8_t *src;
+  void *page;
+} shared[SHARED_MAX];
+static struct spinlock shared_lock;
+
+static struct {
+  volatile uint32_t faults;
+  volatile uint32_t in_place;
+  volatile uint32_t shared;
+  volatile uint32_t copied;
+  volatile uint32_t zero;
+  volatile uint32_t cow;
+} stats;
+
+static void map_mega(uintptr_t pa, size_t size, uint32_t flags) {
+  // the last byte, the end may wrap around on rv32
+  uintptr_t last = pa + size - 1;
+  for (uintptr_t i = VPN1(pa); i <= VPN1(last); i++)
+    kernel_root[i] =
+        PA_TO_PTE(i * MEGAPAGE_SIZE) | flags | PTE_G | PTE_A | PTE_D | PTE_V;
+}
+
+// the megapages holding the stacks are split into pages, to leave the guard
+// pages unmapped, see stack.h. the stacks follow the image, they may cross
+// into the next megapage
+static void map_stacks() {
+  uintptr_t begin = (uintptr_t)__STACKS_BEGIN__;
+  uintptr_t end = (uintptr_t)__STACKS_END__;
+
+  for (uintptr_t mega = begin & ~(MEGAPAGE_SIZE - 1); mega < end;
+       mega += MEGAPAGE_SIZE) {
+    uint32_t *table = page_alloc();
+
+    for (size_t i = 0; i < 1024; i++) {
+      uintptr_t pa = mega + i * PAGE_SIZE;
+      int guard =
+          pa >= begin && pa < end && (pa - begin) % STACK_SLOT < STACK_GUARD;
+      table[i] = guard ? 0
+                       : PA_TO_PTE(pa) | PTE_R | PTE_W | PTE_X | PTE_G |
+                             PTE_A | PTE_D | PTE_V;
+    }
+    kernel_root[VPN1(mega)] = PA_TO_PTE((uintptr_t)table) | PTE_V;
+  }
+}
+
+void vm_init() {
+  kernel_root = page_alloc();
+  zero_page = page_alloc();
+
+  // ram, and the devices used by the kernel
+  for (size_t i = 0; i < board.nmemory; i++)
+    map_mega(board.memory[i].begin,
+             board.memory[i].end - board.memory[i].begin,
+             PTE_R | PTE_W | PTE_X);
+  map_stacks();
+  map_mega(board.plic, board.plic_size, PTE_R | PTE_W);
+  map_mega(board.uart.base, 0x100, PTE_R | PTE_W);
+  for (size_t i = 0; i < board.nvirtio; i++)
+    map_mega(board.virtio[i].base, 0x1000, PTE_R | PTE_W);
+}
+
+int vm_create(struct vm *vm) {
+  vm->root = page_alloc();
+  vm->nregions = 0;
+  if (!vm->root)
+    return 0;
+
+  memcpy(vm->root, kernel_root, PAGE_SIZE);
+  return 1;
+}
+
+void vm_destroy(struct vm *vm) {
+  for (size_t i = 0; i < VPN1(USER_TOP); i++) {
+    if (!(vm->root[i] & PTE_V))
+      continue;
+
+    uint32_t *table = (uint32_t *)PTE_TO_PA(vm->root[i]);
+    for (size_t j = 0; j < 1024; j++)
+      if (table[j] & PTE_V)
+        page_unref((void *)PTE_TO_PA(table[j]));
+    page_free(table);
+  }
+
+  page_free(vm->root);
+  vm->root = NULL;
+}
+
+int vm_map(struct vm *vm, uintptr_t start, uintptr_t end, uint32_t prot,
+           const void *file, size_t filesz) {
+  uintptr_t first = start & ~(PAGE_SIZE - 1);
+  uintptr_t last = (end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+  if (vm->nregions == VM_MAX_REGIONS || start >= end || first < USER_BASE ||
+      last > USER_TOP || filesz > end - start)
+    return 0;
+
+  for (size_t i = 0; i < vm->nregions; i++) {
+    struct vm_region *r = &vm->regions[i];
+    if (first < ((r->end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1)) &&
+        (r->start & ~(PAGE_SIZE - 1)) < last)
+      return 0;
+  }
+
+  vm->regions[vm->nregions++] = (struct vm_region){
+      .start = start,
+      .end = end,
+      .prot = prot & (PTE_R | PTE_W | PTE_X),
+      .file = file,
+      .filesz = filesz,
+  };
+  return 1;
+}
+
+static struct vm_region *region(struct vm *vm, uintptr_t va) {
+  for (size_t i = 0; i < vm->nregions; i++) {
+    struct vm_region *r = &vm->regions[i];
+    if (va >= (r->start & ~(PAGE_SIZE - 1)) && va < r->end)
+      return r;
+  }
+  return NULL;
+}
+
+int vm_check(struct vm *vm, uintptr_t start, size_t len, uint32_t prot) {
+  if (start >= USER_TOP || len > USER_TOP - start)
+    return 0;
+
+  for (uintptr_t va = start & ~(PAGE_SIZE - 1); va < start + len;
+       va += PAGE_SIZE) {
+    struct vm_region *r = region(vm, va > start ? va : start);
+    if (!r || (r->prot & prot) != prot)
+      return 0;
+  }
+  return 1;
+}
+
+static uint32_t *walk(struct vm *vm, uintptr_t va) {
+  uint32_t *pte = &vm->root[VPN1(va)];
+  if (!(*pte & PTE_V)) {
+    void *table = page_alloc();
+    if (!table)
+      return NULL;
+    *pte = PA_TO_PTE(table) | PTE_V;
+  }
+  return &((uint32_t *)PTE_TO_PA(*pte))[VPN0(va)];
+}
+
+// the shared copy of a file page. the returned page holds a reference for
+// the caller
+static void *shared_page(const uint8_t *src) {
+  // in place, if the file happens to be page aligned. the initrd is a
+  // reserved range, page_ref ignores it
+  if (!((uintptr_t)src & (PAGE_SIZE - 1))) {
+    page_ref((void *)src);
+    amoadd(&stats.in_place, 1);
+    return (void *)src;
+  }
+
+  size_t i = ((uintptr_t)src >> 12) % SHARED_MAX;
+  void *page = NULL;
+
+  size_t sie = irq_save();
+  spin_lock(&shared_lock);
+
+  // linear probing
+  for (size_t n = 0; n < SHARED_MAX; n++, i = (i + 1) % SHARED_MAX) {
+    if (shared[i].src == src) {
+      page = shared[i].page;
+      break;
+    }
+    if (!shared[i].src) {
+      // copied with the lock held, so two harts dont copy the same page
+      page = page_alloc();
+      if (page) {
+        memcpy(page, src, PAGE_SIZE);
+        shared[i].src = src;
+        shared[i].page = page;
+        amoadd(&stats.copied, 1);
+      }
+      break;
+    }
+  }
+
+  if (page)
+    page_ref(page);
+
+  spin_unlock(&shared_lock);
+  irq_restore(sie);
+
+  if (page)
+    amoadd(&stats.shared, 1);
+  return page;
+}
+
+// a private page with the contents of the region at va
+static void *private_page(struct vm_region *r, uintptr_t va) {
+  uint8_t *page = page_alloc();
+  if (!page)
+    return NULL;
+
+  uintptr_t from = va < r->start ? r->start : va;
+  uintptr_t to = va + PAGE_SIZE;
+  if (to > r->start + r->filesz)
+    to = r->start + r->filesz;
+
+  if (from < to)
+    memcpy(page + (from - va), r->file + (from - r->start), to - from);
+
+  return page;
+}
+
+int vm_map_page(struct vm *vm, uintptr_t va, void *page, uint32_t prot) {
+  uint32_t *pte = walk(vm, va);
+  if (!pte)
+    return 0;
+
+  page_ref(page);
+  *pte = PA_TO_PTE(page) | (prot & (PTE_R | PTE_W | PTE_X)) | PTE_U | PTE_A |
+         PTE_D | PTE_V;
+  return 1;
+}
+
+int vm_fault(struct vm *vm, uintptr_t va, size_t cause) {
+  va &= ~(PAGE_SIZE - 1);
+
+  struct vm_region *r = region(vm, va);
+  if (!r)
+    return 0;
+
+  int write = cause == EXC_STORE_AMO_PAGE_FAULT;
+  uint32_t need = write                                   ? PTE_W
+                  : cause == EXC_INSTRUCTION_PAGE_FAULT ? PTE_X
+                                                          : PTE_R;
+  if (!(r->prot & need))
+    return 0;
+
+  uint32_t *pte = walk(vm, va);
+  if (!pte)
+    return 0;
+
+  amoadd(&stats.faults, 1);
+
+  uint32_t flags = r->prot | PTE_U | PTE_A | PTE_V;
+  void *page;
+
+  if (*pte & PTE_V) {
+    // a mapped page only faults for a write to a copy-on-write page
+    if (!write || !(*pte & PTE_COW))
+      return 0;
+
+    void *old = (void *)PTE_TO_PA(*pte);
+    page = page_alloc();
+    if (!page)
+      return 0;
+    memcpy(page, old, PAGE_SIZE);
+    page_unref(old);
+
+    *pte = PA_TO_PTE(page) | flags | PTE_D;
+    sfence_vma(va);
+    amoadd(&stats.cow, 1);
+    return 1;
+  }
+
+  int whole = va >= r->start && va + PAGE_SIZE <= r->start + r->filesz;
+  int none = va >= r->start + r->filesz;
+
+  if (write) {
+    // the first access is a write, there is nothing to share
+    page = private_page(r, va);
+    flags |= PTE_D;
+  } else if (whole) {
+    page = shared_page(r->file + (va - r->start));
+    if (r->prot & PTE_W)
+      flags = (flags & ~PTE_W) | PTE_COW;
+  } else if (none) {
+    page = zero_page;
+    page_ref(page);
+    flags = (flags & ~PTE_W) | ((r->prot & PTE_W) ? PTE_COW : 0);
+    amoadd(&stats.zero, 1);
+  } else {
+    // the file ends within this page
+    page = private_page(r, va);
+    flags |= PTE_D;
+  }
+
+  if (!page)
+    return 0;
+
+  *pte = PA_TO_PTE(page) | flags;
+  sfence_vma(va);
+  return 1;
+}
+
+void vm_activate(struct vm *vm) {
+  csrw(satp, SATP_MODE_SV32 | ((uintptr_t)vm->root >> 12));
+  sfence_vma_all;
+}
+
+void vm_deactivate() {
+  csrw(satp, 0);
+  sfence_vma_all;
+}
+
+void vm_report() {
+  print("vm: faults ");
+  print_num(10, stats.faults);
+  print(", zero fill ");
+  print_num(10, stats.zero);
+  print(", copy-on-write ");
+  print_num(10, stats.cow);
+  print("\n  shared ");
+  print_num(10, stats.shared);
+  print(", of which copied ");
+  print_num(10, stats.copied);
+  print(", in place ");
+  print_num(10, stats.in_place);
+  print("\n");
+}
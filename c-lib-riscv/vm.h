@@ -0,0 +1,86 @@
+#ifndef VM_H
+#define VM_H
+
+#include "page.h"
+#include "riscv.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// user address spaces, with sv32 paging.
+//
+// the kernel runs untranslated. while a process runs, its page table maps the
+// user range, and the ram and mmio of the kernel, identity mapped with global
+// megapages, which every table shares.
+//
+// nothing is mapped up front. a region only records where its contents come
+// from, pages are filled in on the first access, by vm_fault:
+//
+// * pages of read-only regions, backed by a file, are shared by every process
+//   mapping the same file. if the file data is page aligned, the pages are
+//   mapped in place, otherwise they are copied once, into a shared cache.
+// * pages of writable regions are mapped to the same shared pages, read-only
+//   and marked copy-on-write. the first write gets a private copy.
+// * pages past the end of the file (.bss, the stack) map a shared zero page
+//   on read, and get a fresh page on the first write.
+
+// the user range ends below the first mmio device of the virt board, the
+// clint
+#define USER_BASE (PAGE_SIZE)
+#define USER_TOP (0x02000000)
+
+// the vdso page sits at the top, the stack right below it
+#define VDSO_BASE (USER_TOP - PAGE_SIZE)
+#define USER_STACK_TOP (VDSO_BASE)
+#define USER_STACK_SIZE (64 * PAGE_SIZE)
+
+// marks a read-only mapping of a writable page
+#define PTE_COW (PTE_RSW0)
+
+#define VM_MAX_REGIONS (8)
+
+struct vm_region {
+  uintptr_t start, end;
+  // PTE_R, PTE_W, PTE_X
+  uint32_t prot;
+  // the contents of the first filesz bytes of the region, the rest is zero
+  const uint8_t *file;
+  size_t filesz;
+};
+
+struct vm {
+  uint32_t *root;
+  struct vm_region regions[VM_MAX_REGIONS];
+  size_t nregions;
+};
+
+// build the kernel mappings and the zero page. called once, after page_init
+void vm_init();
+
+int vm_create(struct vm *vm);
+
+// unmap everything and free the page tables
+void vm_destroy(struct vm *vm);
+
+// add a region. it must not share a page with another one. returns 0, if it
+// is out of the user range or overlaps
+int vm_map(struct vm *vm, uintptr_t start, uintptr_t end, uint32_t prot,
+           const void *file, size_t filesz);
+
+// map a page right away, outside of any region. it takes a reference on it
+int vm_map_page(struct vm *vm, uintptr_t va, void *page, uint32_t prot);
+
+// 1, if regions with prot cover every page of start..start+len. system calls
+// check user buffers with it, before they touch them
+int vm_check(struct vm *vm, uintptr_t start, size_t len, uint32_t prot);
+
+// resolve a page fault at va. returns 0, if the access is not allowed
+int vm_fault(struct vm *vm, uintptr_t va, size_t cause);
+
+// switch the calling hart to the address space, or back to bare mode
+void vm_activate(struct vm *vm);
+void vm_deactivate();
+
+// faults by kind, shared and copied pages
+void vm_report();
+
+#endif
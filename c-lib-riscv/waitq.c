@@ -0,0 +1,62 @@
+#include "waitq.h"
+#include "atomic.h"
+#include "console.h"
+#include "softirq.h"
+
+// harts in machine mode. sstatus reads the same there, as in the supervisor
+// mode it was entered from, so sie may well be set
+static volatile uint8_t machine[MAX_HARTS];
+
+void wait_machine_enter() { machine[hartid()] = 1; }
+
+void wait_machine_exit() { machine[hartid()] = 0; }
+
+int wait_can_park(struct wait_queue *wq) {
+  size_t status;
+  csrr(status, sstatus);
+
+  // supervisor interrupts do not end a wfi in machine mode
+  return (status & XSTATUS_SIE) && (wq->harts & (1 << hartid())) &&
+         !softirq_in_trap() && !machine[hartid()];
+}
+
+void wait_park(struct wait_queue *wq) {
+  uint32_t bit = 1 << hartid();
+
+  amoor(&wq->waiting, bit);
+  if (wq->arm)
+    wq->arm(wq);
+  wfi;
+  amoand(&wq->waiting, ~bit);
+  amoadd(&wq->parks, 1);
+}
+
+void wait_done(struct wait_queue *wq, int can_park, int parked) {
+  amoadd(&wq->waits, 1);
+  if (!can_park)
+    amoadd(&wq->spun, 1);
+  else if (!parked)
+    amoadd(&wq->spin_hits, 1);
+}
+
+void wake_up(struct wait_queue *wq) {
+  if (wq->waiting)
+    amoadd(&wq->wakes, 1);
+}
+
+void wait_report(struct wait_queue *wq) {
+  print("wait: queue, waits, spin hits, parks, wakes, spun\n");
+  print("  ");
+  print(wq->name);
+  print(", ");
+  print_num(10, wq->waits);
+  print(", ");
+  print_num(10, wq->spin_hits);
+  print(", ");
+  print_num(10, wq->parks);
+  print(", ");
+  print_num(10, wq->wakes);
+  print(", ");
+  print_num(10, wq->spun);
+  print("\n");
+}
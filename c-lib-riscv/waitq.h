@@ -0,0 +1,86 @@
+#ifndef WAITQ_H
+#define WAITQ_H
+
+#include "riscv.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// wait queues, to park a hart until a device interrupt fires, instead of
+// polling the device registers.
+//
+// wait_event checks the condition, spins for up to spin_ns, for devices which
+// are usually ready within a few microseconds, and then parks the hart in
+// wfi. the top half of the device calls wake_up. there is no scheduler, a
+// parked hart is free to take interrupts, and to sleep otherwise.
+//
+// there are no ipis either, a hart in wfi is only woken by its own
+// interrupts. so a hart only parks, if the waking interrupt is routed to it,
+// see harts, and only from the worker or a syscall. in a trap the plic
+// threshold may hold the device off. in any other case, or with interrupts
+// off, wait_event spins until the condition holds.
+struct wait_queue {
+  const char *name;
+
+  // harts the waking interrupt is routed to
+  volatile uint32_t harts;
+
+  // called with interrupts off, right before a hart parks. enables the
+  // interrupt, which ends the wait
+  void (*arm)(struct wait_queue *wq);
+
+  // parked harts
+  volatile uint32_t waiting;
+
+  volatile uint32_t waits;
+  volatile uint32_t spin_hits;
+  volatile uint32_t parks;
+  volatile uint32_t wakes;
+  volatile uint32_t spun;
+};
+
+// the calling hart runs in machine mode, at boot or in an ecall, and leaves it
+// again. it never parks in between, see wait_can_park
+void wait_machine_enter();
+void wait_machine_exit();
+
+// 1, if the calling hart may park on the queue
+int wait_can_park(struct wait_queue *wq);
+
+// wfi until the next interrupt, called with interrupts off
+void wait_park(struct wait_queue *wq);
+
+// the counters of a wait, see wait_report
+void wait_done(struct wait_queue *wq, int can_park, int parked);
+
+#define wait_event(wq, cond, spin_ns)                                          \
+  do {                                                                         \
+    if (cond)                                                                  \
+      break;                                                                   \
+                                                                               \
+    int _can_park = wait_can_park(wq), _parked = 0;                            \
+    uint64_t _end = rdtime() + (spin_ns) / (1000000000 / TIMEBASE_HZ);         \
+    while (!(cond)) {                                                          \
+      if (!_can_park || rdtime() < _end)                                       \
+        continue;                                                              \
+                                                                               \
+      /* an interrupt between the check and wfi keeps pending, wfi wakes up    \
+       * for it all the same */                                                \
+      size_t _sie = irq_save();                                                \
+      if (!(cond)) {                                                           \
+        wait_park(wq);                                                         \
+        _parked = 1;                                                           \
+      }                                                                        \
+      irq_restore(_sie);                                                       \
+    }                                                                          \
+    wait_done(wq, _can_park, _parked);                                         \
+  } while (0)
+
+// from the top half of the device. the interrupt already ended the wfi of the
+// harts parked on it, they check their condition once it returns
+void wake_up(struct wait_queue *wq);
+
+// waits that were over after the spin, ended parked, or spun as they could
+// not park
+void wait_report(struct wait_queue *wq);
+
+#endif
@@ -0,0 +1,118 @@
+const tty = @import("tty.zig");
+const mem = @import("mem.zig");
+const heap = @import("heap.zig");
+const exec = @import("exec.zig");
+const csr = @import("cpu.zig").csr;
+
+// qemu's virt machine runs the time csr at 10MHz
+const TIMEBASE_HZ = 10_000_000;
+
+const MAX_SIZE = 1 << 20;
+const TOTAL = 16 << 20; // bytes moved per measurement
+
+var src: [MAX_SIZE]u8 align(64) = undefined;
+var dst: [MAX_SIZE]u8 align(64) = undefined;
+
+const sizes = [_]usize{ 16, 64, 256, 1 << 10, 4 << 10, 16 << 10, 64 << 10, 256 << 10, 1 << 20 };
+
+/// measure memcpy and memset bandwidth across buffer sizes, for the scalar
+/// and, if present, the vector routines. the source is offset by one byte in
+/// the misaligned column.
+pub fn run() void {
+    tty.printf("mem: bench, vector={}\n", .{mem.vector()});
+    tty.print("  size  cpy MB/s  cpy+1 MB/s  set MB/s  (scalar)\n");
+    table(mem.scalar.copy, mem.scalar.set);
+
+    if (mem.vector()) {
+        tty.print("  size  cpy MB/s  cpy+1 MB/s  set MB/s  (rvv)\n");
+        table(mem.copy(), mem.set());
+    }
+}
+
+const HEAP_ROUNDS = 1 << 12;
+const HEAP_LIVE = 64;
+
+const heap_sizes = [_]usize{ 16, 64, 256, 1 << 10, 2 << 10, 8 << 10 };
+
+/// measure alloc and free of the kernel heap, in batches of live objects.
+/// the sizes past 2K take whole pages
+pub fn allocs() void {
+    const a = heap.allocator();
+    var live: [HEAP_LIVE][]u8 = undefined;
+
+    tty.print("heap: bench\n");
+    tty.print("  size  ns/alloc+free\n");
+    for (heap_sizes) |n| {
+        const t = csr.read("time");
+        for (0..HEAP_ROUNDS) |_| {
+            for (&live) |*p| p.* = a.alloc(u8, n) catch {
+                tty.println("heap: out of memory");
+                return;
+            };
+            for (live) |p| a.free(p);
+        }
+        const ns = (csr.read("time") - t) * (1_000_000_000 / TIMEBASE_HZ);
+
+        tty.printf("{d: >6}  {d: >13}\n", .{ n, ns / (HEAP_ROUNDS * HEAP_LIVE) });
+    }
+}
+
+const YIELDERS = 8;
+const YIELDS = 1 << 12;
+
+const Yielder = struct {
+    task: exec.Task = .{ .poll = poll },
+    left: usize = YIELDS,
+
+    fn poll(t: *exec.Task) exec.Poll {
+        const y: *Yielder = @fieldParentPtr("task", t);
+        y.left -= 1;
+        if (y.left == 0) return .done;
+        exec.wake(t);
+        return .pending;
+    }
+};
+
+/// measure a task switch of the executor, tasks which yield right away are
+/// polled in turn. a poll takes the task off the run queue and the yield puts
+/// it back
+pub fn tasks() void {
+    var ys = [_]Yielder{.{}} ** YIELDERS;
+    for (&ys) |*y| exec.spawn(&y.task);
+
+    const polls = exec.stats.polls;
+    const c = csr.read("cycle");
+    while (exec.step()) {}
+    const switches = exec.stats.polls - polls;
+
+    tty.printf("exec: bench, {d} tasks, {d} cycles per switch\n", .{
+        YIELDERS,
+        (csr.read("cycle") - c) / switches,
+    });
+}
+
+fn table(copy: mem.Copy, set: mem.Set) void {
+    for (sizes) |n| {
+        const iters = TOTAL / n;
+        const m = if (n == MAX_SIZE) n - 1 else n;
+
+        var t = csr.read("time");
+        for (0..iters) |_| _ = copy(&dst, &src, n);
+        const cpy = rate(iters * n, csr.read("time") - t);
+
+        t = csr.read("time");
+        for (0..iters) |_| _ = copy(&dst, src[1..].ptr, m);
+        const cpy1 = rate(iters * m, csr.read("time") - t);
+
+        t = csr.read("time");
+        for (0..iters) |_| _ = set(&dst, 0, n);
+        const st = rate(iters * n, csr.read("time") - t);
+
+        tty.printf("{d: >6}  {d: >8}  {d: >10}  {d: >8}\n", .{ n, cpy, cpy1, st });
+    }
+}
+
+fn rate(bytes: usize, ticks: usize) usize {
+    if (ticks == 0) return 0;
+    return bytes * (TIMEBASE_HZ / 1_000_000) / ticks;
+}
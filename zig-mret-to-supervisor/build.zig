@@ -18,15 +18,42 @@ pub fn build(b: *std.Build) !void {
         .code_model = .medium,
     });
 
+    // `zig build -Dbench` runs the benchmarks at boot, on hart 0
+    const options = b.addOptions();
+    options.addOption(bool, "bench", b.option(bool, "bench", "Run benchmarks at boot") orelse false);
+    k.root_module.addOptions("options", options);
+
     k.addAssemblyFile(b.path("entry.S"));
+    k.addAssemblyFile(b.path("mem.S"));
+    k.addAssemblyFile(b.path("trap.S"));
     k.setLinkerScript(b.path("linker.ld"));
 
     b.installArtifact(k);
 
+    // the heap does not depend on the machine, `zig build test` runs its
+    // tests on the host. `zig build heapbench` measures alloc/free there,
+    // with threads standing in for harts
+    const t = b.addTest(.{
+        .root_source_file = b.path("heap.zig"),
+        .target = b.host,
+    });
+    const ts = b.step("test", "Run the heap tests on the host");
+    ts.dependOn(&b.addRunArtifact(t).step);
+
+    const hb = b.addExecutable(.{
+        .name = "heapbench",
+        .root_source_file = b.path("heap_bench.zig"),
+        .target = b.host,
+        .optimize = .ReleaseFast,
+    });
+    const hbs = b.step("heapbench", "Measure heap alloc/free throughput on the host");
+    hbs.dependOn(&b.addRunArtifact(hb).step);
+
     // some useful args to pass via
     // `zig build run -- <args>`:
     // * -s -S ; for debugging
     // * -smp <n> ; set n cores
+    // * -cpu rv64,v=true ; enable the vector extension
     const q = b.addSystemCommand(&.{
         "qemu-system-riscv64",
         "-machine",
@@ -4,6 +4,13 @@ pub inline fn hang() noreturn {
     }
 }
 
+/// the hartid is kept in the thread pointer, see entry.S
+pub inline fn hartid() usize {
+    return asm volatile ("mv %[ret], tp"
+        : [ret] "=r" (-> usize),
+    );
+}
+
 pub const csr = struct {
     pub inline fn read(r: []const u8) usize {
         return asm volatile ("csrr a0, " ++ r
@@ -0,0 +1,211 @@
+const std = @import("std");
+const csr = @import("cpu.zig").csr;
+
+// a cooperative executor of stackless tasks, for one hart.
+//
+// a task is a state machine. poll advances it as far as it can and returns
+// .pending when it has to wait, after it registered with what it waits for.
+// that is a Waiters list, which the uart interrupt wakes, see uart.zig, or
+// the timer queue, see sleep. wake puts a task back on the run queue. the
+// executor only polls tasks on the run queue, when it is empty the hart
+// sleeps in wfi. nothing spins, so one hart runs many io bound tasks.
+//
+// the run queue, the waiters and the timer queue are shared with the
+// interrupt handlers, and only touched with interrupts off.
+
+pub const Poll = enum { pending, done };
+
+pub const Task = struct {
+    poll: *const fn (*Task) Poll,
+
+    // the run queue
+    next: ?*Task = null,
+    queued: bool = false,
+
+    // a task waits for one thing at a time
+    wait_next: ?*Task = null,
+    waiting: bool = false,
+    timer_next: ?*Task = null,
+    deadline: u64 = 0,
+    sleeping: bool = false,
+};
+
+const SSTATUS_SIE = 1 << 1;
+
+// the supervisor timer compare csr of the sstc extension
+const STIMECMP = "0x14d";
+
+// qemu's virt machine runs the time csr at 10MHz
+const TIMEBASE_HZ = 10_000_000;
+
+/// set in machine mode, if the hart has sstc, see main.zig
+pub var sstc = false;
+
+var head: ?*Task = null;
+var tail: ?*Task = null;
+var timers: ?*Task = null;
+
+pub const Stats = struct {
+    spawned: usize = 0,
+    done: usize = 0,
+    polls: usize = 0,
+    poll_cycles: usize = 0,
+    idle_ticks: usize = 0,
+    start: usize = 0,
+};
+
+pub var stats: Stats = .{};
+
+pub inline fn irqSave() usize {
+    return asm volatile ("csrrci %[ret], sstatus, 2"
+        : [ret] "=r" (-> usize),
+    ) & SSTATUS_SIE;
+}
+
+pub inline fn irqRestore(sie: usize) void {
+    csr.set("sstatus", sie);
+}
+
+pub fn spawn(t: *Task) void {
+    stats.spawned += 1;
+    wake(t);
+}
+
+/// put the task on the run queue, unless it is there already. from tasks and
+/// interrupt handlers. a task that wakes itself yields
+pub fn wake(t: *Task) void {
+    const s = irqSave();
+    defer irqRestore(s);
+
+    if (t.queued) return;
+    t.queued = true;
+    t.next = null;
+    if (tail) |l| l.next = t else head = t;
+    tail = t;
+}
+
+pub const Waiters = struct {
+    head: ?*Task = null,
+
+    /// park the task until wakeAll, it must return .pending next. check the
+    /// condition and wait with interrupts off, or a wake in between is lost
+    pub fn wait(w: *Waiters, t: *Task) void {
+        const s = irqSave();
+        defer irqRestore(s);
+
+        if (t.waiting) return;
+        t.waiting = true;
+        t.wait_next = w.head;
+        w.head = t;
+    }
+
+    pub fn wakeAll(w: *Waiters) void {
+        const s = irqSave();
+        defer irqRestore(s);
+
+        var next = w.head;
+        w.head = null;
+        while (next) |t| {
+            next = t.wait_next;
+            t.waiting = false;
+            wake(t);
+        }
+    }
+};
+
+/// the deadline ns from now, for sleep
+pub fn after(ns: u64) u64 {
+    return csr.read("time") + ns / (1_000_000_000 / TIMEBASE_HZ);
+}
+
+/// .done once the deadline passed, until then the timer interrupt wakes the
+/// task. without sstc there is no timer for the supervisor, the task is
+/// polled again and again, and the hart does not idle
+pub fn sleep(t: *Task, deadline: u64) Poll {
+    if (csr.read("time") >= deadline) return .done;
+
+    if (!sstc) {
+        wake(t);
+        return .pending;
+    }
+
+    const s = irqSave();
+    defer irqRestore(s);
+    if (t.sleeping) return .pending;
+
+    // sorted by deadline, the first one is programmed
+    var link = &timers;
+    while (link.*) |o| : (link = &o.timer_next) {
+        if (o.deadline > deadline) break;
+    }
+    t.deadline = deadline;
+    t.sleeping = true;
+    t.timer_next = link.*;
+    link.* = t;
+    csr.write(STIMECMP, timers.?.deadline);
+    return .pending;
+}
+
+/// wake the tasks whose deadline passed. writing stimecmp clears the
+/// interrupt, if it is in the future
+pub fn timerInterrupt() void {
+    const now = csr.read("time");
+    while (timers) |t| {
+        if (t.deadline > now) break;
+        timers = t.timer_next;
+        t.sleeping = false;
+        wake(t);
+    }
+    csr.write(STIMECMP, if (timers) |t| t.deadline else std.math.maxInt(u64));
+}
+
+/// poll the first task of the run queue. false, if there is none
+pub fn step() bool {
+    const s = irqSave();
+    const t = head orelse {
+        irqRestore(s);
+        return false;
+    };
+    head = t.next;
+    if (head == null) tail = null;
+    t.queued = false;
+    irqRestore(s);
+
+    const c = csr.read("cycle");
+    if (t.poll(t) == .done) stats.done += 1;
+    stats.poll_cycles += csr.read("cycle") - c;
+    stats.polls += 1;
+    return true;
+}
+
+pub fn run() noreturn {
+    stats.start = csr.read("time");
+    while (true) {
+        if (step()) continue;
+
+        // wfi wakes up for a pending interrupt with sie off, too. so a wake
+        // between the check and the wfi is not lost. the handler runs once
+        // sie is back on
+        csr.clear("sstatus", SSTATUS_SIE);
+        if (head == null) {
+            const t = csr.read("time");
+            asm volatile ("wfi");
+            stats.idle_ticks += csr.read("time") - t;
+        }
+        csr.set("sstatus", SSTATUS_SIE);
+    }
+}
+
+/// the counters, and the share of time the hart slept since run
+pub fn format(buf: []u8) []const u8 {
+    const total = csr.read("time") - stats.start;
+    const idle = if (total == 0) 0 else stats.idle_ticks * 100 / total;
+    const cycles = if (stats.polls == 0) 0 else stats.poll_cycles / stats.polls;
+    return std.fmt.bufPrint(buf, "exec: tasks {d}, done {d}, polls {d}, cycles/poll {d}, idle {d}%\n\r", .{
+        stats.spawned,
+        stats.done,
+        stats.polls,
+        cycles,
+        idle,
+    }) catch buf;
+}
@@ -0,0 +1,400 @@
+const std = @import("std");
+const builtin = @import("builtin");
+const cpu = @import("cpu.zig");
+
+// the kernel heap, a std.mem.Allocator over the pages between __heap_start$
+// and __heap_end$, see linker.ld.
+//
+// small allocations are rounded up to a power of 2 size class, from 16 bytes
+// to 2K. each hart keeps a free list per class, so alloc and free usually
+// touch nothing another hart uses. an empty list takes a batch from the
+// class's depot, or carves a fresh page into objects. a list that grew too
+// long gives a batch back to the depot, where other harts find it. pages
+// carved for a class stay with it.
+//
+// larger allocations take runs of whole pages. freed runs are kept in address
+// order and merged with their neighbours, the first one that fits is reused.
+//
+// an object's class follows from its length and alignment, which the
+// allocator interface passes to free again, so there are no headers. the
+// caches are not safe against interrupt handlers on the same hart, do not
+// allocate from them.
+
+pub const PAGE_SIZE = 4096;
+pub const MAX_HARTS = 8;
+
+const MIN_SHIFT = 4;
+const MAX_SHIFT = 11;
+const CLASSES = MAX_SHIFT - MIN_SHIFT + 1;
+
+// objects moved between a cache and the depot at once
+const BATCH = 32;
+
+const Free = struct {
+    next: ?*Free,
+};
+
+const Run = struct {
+    next: ?*Run,
+    pages: usize,
+};
+
+const SpinLock = struct {
+    locked: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+
+    fn lock(l: *SpinLock) void {
+        while (l.locked.cmpxchgWeak(false, true, .acquire, .monotonic) != null) {
+            // wait with plain loads, so the line is not bounced between harts
+            while (l.locked.load(.monotonic)) std.atomic.spinLoopHint();
+        }
+    }
+
+    fn unlock(l: *SpinLock) void {
+        l.locked.store(false, .release);
+    }
+};
+
+// 128 bytes on rv64, the caches of two harts never share a line
+const Cache = struct {
+    lists: [CLASSES]?*Free = [_]?*Free{null} ** CLASSES,
+    counts: [CLASSES]usize = [_]usize{0} ** CLASSES,
+};
+
+const Depot = struct {
+    lock: SpinLock = .{},
+    list: ?*Free = null,
+};
+
+// the caches are indexed by hart. the host tests run harts as threads and
+// set this instead
+pub threadlocal var test_hart: usize = 0;
+
+fn hart() usize {
+    if (builtin.os.tag == .freestanding) return cpu.hartid();
+    return test_hart;
+}
+
+fn class(len: usize, log2_align: u8) ?usize {
+    const alignment = @as(usize, 1) << @intCast(log2_align);
+    const size = @max(len, alignment, 1 << MIN_SHIFT);
+    if (size > 1 << MAX_SHIFT) return null;
+    return std.math.log2_int_ceil(usize, size) - MIN_SHIFT;
+}
+
+fn classSize(c: usize) usize {
+    return @as(usize, 1) << @intCast(c + MIN_SHIFT);
+}
+
+fn pages(len: usize) usize {
+    return (len + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+pub const Heap = struct {
+    caches: [MAX_HARTS]Cache align(64) = [_]Cache{.{}} ** MAX_HARTS,
+    depots: [CLASSES]Depot = [_]Depot{.{}} ** CLASSES,
+
+    // pages, never handed out before, from next to end, and freed runs
+    lock: SpinLock = .{},
+    next: usize = 0,
+    end: usize = 0,
+    runs: ?*Run = null,
+
+    pub fn init(start: usize, end: usize) Heap {
+        return .{
+            .next = std.mem.alignForward(usize, start, PAGE_SIZE),
+            .end = std.mem.alignBackward(usize, end, PAGE_SIZE),
+        };
+    }
+
+    pub fn allocator(h: *Heap) std.mem.Allocator {
+        return .{ .ptr = h, .vtable = &vtable };
+    }
+
+    const vtable = std.mem.Allocator.VTable{
+        .alloc = alloc,
+        .resize = resize,
+        .free = free,
+    };
+
+    fn alloc(ctx: *anyopaque, len: usize, log2_align: u8, ret_addr: usize) ?[*]u8 {
+        _ = ret_addr;
+        const h: *Heap = @ptrCast(@alignCast(ctx));
+
+        if (class(len, log2_align)) |c| {
+            const cache = &h.caches[hart()];
+            if (cache.lists[c] == null and !h.refill(cache, c)) return null;
+
+            const f = cache.lists[c].?;
+            cache.lists[c] = f.next;
+            cache.counts[c] -= 1;
+            return @ptrCast(f);
+        }
+
+        if (@as(usize, 1) << @intCast(log2_align) > PAGE_SIZE) return null;
+        const p: [*]u8 = @ptrFromInt(h.allocPages(pages(len)) orelse return null);
+        return p;
+    }
+
+    fn resize(ctx: *anyopaque, buf: []u8, log2_align: u8, new_len: usize, ret_addr: usize) bool {
+        _ = ret_addr;
+        const h: *Heap = @ptrCast(@alignCast(ctx));
+
+        // in place, as long as the class stays the same
+        if (class(buf.len, log2_align)) |c| {
+            const new = class(new_len, log2_align) orelse return false;
+            return new == c;
+        }
+        if (class(new_len, log2_align) != null) return false;
+
+        const old = pages(buf.len);
+        const new = pages(new_len);
+        if (new > old) return false;
+        if (new < old) h.freePages(@intFromPtr(buf.ptr) + new * PAGE_SIZE, old - new);
+        return true;
+    }
+
+    fn free(ctx: *anyopaque, buf: []u8, log2_align: u8, ret_addr: usize) void {
+        _ = ret_addr;
+        const h: *Heap = @ptrCast(@alignCast(ctx));
+
+        if (class(buf.len, log2_align)) |c| {
+            const cache = &h.caches[hart()];
+            const f: *Free = @ptrCast(@alignCast(buf.ptr));
+            f.next = cache.lists[c];
+            cache.lists[c] = f;
+            cache.counts[c] += 1;
+            if (cache.counts[c] > 2 * BATCH) h.drain(cache, c);
+            return;
+        }
+
+        h.freePages(@intFromPtr(buf.ptr), pages(buf.len));
+    }
+
+    fn refill(h: *Heap, cache: *Cache, c: usize) bool {
+        const d = &h.depots[c];
+        var n: usize = 0;
+
+        d.lock.lock();
+        while (n < BATCH) : (n += 1) {
+            const f = d.list orelse break;
+            d.list = f.next;
+            f.next = cache.lists[c];
+            cache.lists[c] = f;
+        }
+        d.lock.unlock();
+
+        if (n == 0) {
+            const page = h.allocPages(1) orelse return false;
+            const size = classSize(c);
+            var off: usize = PAGE_SIZE;
+            while (off > 0) {
+                off -= size;
+                const f: *Free = @ptrFromInt(page + off);
+                f.next = cache.lists[c];
+                cache.lists[c] = f;
+                n += 1;
+            }
+        }
+
+        cache.counts[c] += n;
+        return true;
+    }
+
+    fn drain(h: *Heap, cache: *Cache, c: usize) void {
+        const d = &h.depots[c];
+
+        d.lock.lock();
+        defer d.lock.unlock();
+        for (0..BATCH) |_| {
+            const f = cache.lists[c].?;
+            cache.lists[c] = f.next;
+            f.next = d.list;
+            d.list = f;
+        }
+        cache.counts[c] -= BATCH;
+    }
+
+    fn allocPages(h: *Heap, n: usize) ?usize {
+        h.lock.lock();
+        defer h.lock.unlock();
+
+        var link = &h.runs;
+        while (link.*) |r| : (link = &r.next) {
+            if (r.pages < n) continue;
+
+            // take the head of the run, the rest stays
+            if (r.pages == n) {
+                link.* = r.next;
+            } else {
+                const rest: *Run = @ptrFromInt(@intFromPtr(r) + n * PAGE_SIZE);
+                rest.* = .{ .next = r.next, .pages = r.pages - n };
+                link.* = rest;
+            }
+            return @intFromPtr(r);
+        }
+
+        if (h.end - h.next < n * PAGE_SIZE) return null;
+        const addr = h.next;
+        h.next += n * PAGE_SIZE;
+        return addr;
+    }
+
+    fn freePages(h: *Heap, addr: usize, n: usize) void {
+        h.lock.lock();
+        defer h.lock.unlock();
+
+        var prev: ?*Run = null;
+        var next = h.runs;
+        while (next) |r| {
+            if (@intFromPtr(r) > addr) break;
+            prev = r;
+            next = r.next;
+        }
+
+        const run: *Run = @ptrFromInt(addr);
+        run.* = .{ .next = next, .pages = n };
+        if (next) |r| {
+            if (addr + n * PAGE_SIZE == @intFromPtr(r)) {
+                run.pages += r.pages;
+                run.next = r.next;
+            }
+        }
+
+        if (prev) |p| {
+            if (@intFromPtr(p) + p.pages * PAGE_SIZE == addr) {
+                p.pages += run.pages;
+                p.next = run.next;
+            } else {
+                p.next = run;
+            }
+        } else {
+            h.runs = run;
+        }
+    }
+};
+
+extern const @"__heap_start$": u8;
+extern const @"__heap_end$": u8;
+
+var kernel: Heap = .{};
+
+/// hand the pages from the linker script to the heap. once, before the
+/// first allocation
+pub fn init() void {
+    kernel = Heap.init(@intFromPtr(&@"__heap_start$"), @intFromPtr(&@"__heap_end$"));
+}
+
+pub fn allocator() std.mem.Allocator {
+    return kernel.allocator();
+}
+
+/// for request scoped work, everything is freed at once with deinit
+pub fn arena() std.heap.ArenaAllocator {
+    return std.heap.ArenaAllocator.init(allocator());
+}
+
+const testing = std.testing;
+
+fn testHeap(len: usize) !struct { mem: []align(PAGE_SIZE) u8, heap: Heap } {
+    const mem = try testing.allocator.alignedAlloc(u8, PAGE_SIZE, len);
+    return .{ .mem = mem, .heap = Heap.init(@intFromPtr(mem.ptr), @intFromPtr(mem.ptr) + len) };
+}
+
+test "every class is aligned and usable" {
+    var t = try testHeap(1 << 20);
+    defer testing.allocator.free(t.mem);
+    const a = t.heap.allocator();
+
+    for ([_]usize{ 1, 15, 16, 17, 100, 1000, 2048, 2049, 5000, 3 * PAGE_SIZE }) |n| {
+        const p = try a.alloc(u8, n);
+        defer a.free(p);
+        @memset(p, 0xaa);
+        const c = class(n, 0);
+        const size = if (c) |cl| classSize(cl) else PAGE_SIZE;
+        try testing.expect(std.mem.isAligned(@intFromPtr(p.ptr), size));
+    }
+
+    const q = try a.alignedAlloc(u8, 256, 20);
+    defer a.free(q);
+    try testing.expect(std.mem.isAligned(@intFromPtr(q.ptr), 256));
+}
+
+test "freed objects are reused by the same hart" {
+    var t = try testHeap(1 << 20);
+    defer testing.allocator.free(t.mem);
+    const a = t.heap.allocator();
+
+    const p = try a.create(u64);
+    a.destroy(p);
+    try testing.expectEqual(p, try a.create(u64));
+}
+
+test "caches drain to the depot for other harts" {
+    var t = try testHeap(1 << 20);
+    defer testing.allocator.free(t.mem);
+    const a = t.heap.allocator();
+    defer test_hart = 0;
+
+    var objs: [4 * BATCH]*[64]u8 = undefined;
+    for (&objs) |*o| o.* = try a.create([64]u8);
+    const used = t.heap.next;
+    for (objs) |o| a.destroy(o);
+
+    // hart 1 starts empty, it gets the batches hart 0 gave back
+    test_hart = 1;
+    for (objs[0 .. 2 * BATCH]) |*o| o.* = try a.create([64]u8);
+    try testing.expectEqual(used, t.heap.next);
+}
+
+test "large runs merge and are reused" {
+    var t = try testHeap(1 << 20);
+    defer testing.allocator.free(t.mem);
+    const a = t.heap.allocator();
+
+    const x = try a.alloc(u8, 2 * PAGE_SIZE);
+    const y = try a.alloc(u8, 3 * PAGE_SIZE);
+    const z = try a.alloc(u8, PAGE_SIZE);
+    a.free(y);
+    a.free(x);
+    a.free(z);
+
+    const w = try a.alloc(u8, 6 * PAGE_SIZE);
+    defer a.free(w);
+    try testing.expectEqual(x.ptr, w.ptr);
+}
+
+test "resize in place" {
+    var t = try testHeap(1 << 20);
+    defer testing.allocator.free(t.mem);
+    const a = t.heap.allocator();
+
+    const p = try a.alloc(u8, 20);
+    try testing.expect(a.resize(p, 32));
+    try testing.expect(!a.resize(p, 33));
+    a.free(p.ptr[0..32]);
+
+    const q = try a.alloc(u8, 4 * PAGE_SIZE);
+    try testing.expect(a.resize(q, PAGE_SIZE + 1));
+    a.free(q.ptr[0 .. PAGE_SIZE + 1]);
+}
+
+test "out of memory" {
+    var t = try testHeap(4 * PAGE_SIZE);
+    defer testing.allocator.free(t.mem);
+    const a = t.heap.allocator();
+
+    try testing.expectError(error.OutOfMemory, a.alloc(u8, 8 * PAGE_SIZE));
+}
+
+test "arena on top" {
+    var t = try testHeap(1 << 20);
+    defer testing.allocator.free(t.mem);
+
+    var ar = std.heap.ArenaAllocator.init(t.heap.allocator());
+    defer ar.deinit();
+    const a = ar.allocator();
+    for (0..100) |i| {
+        const s = try std.fmt.allocPrint(a, "request {d}", .{i});
+        try testing.expect(s.len > 0);
+    }
+}
@@ -0,0 +1,51 @@
+const std = @import("std");
+const heap = @import("heap.zig");
+
+// alloc and free throughput of the kernel heap on the host, see build.zig.
+// every thread stands in for a hart, with its own cache. the thread safe
+// GeneralPurposeAllocator of std, behind one lock, is the baseline
+
+const ROUNDS = 1 << 14;
+const LIVE = 64;
+const HARTS = 4;
+
+const sizes = [_]usize{ 16, 64, 256, 1 << 10, 2 << 10, 8 << 10 };
+
+var memory: [256 << 20]u8 align(heap.PAGE_SIZE) = undefined;
+
+fn worker(a: std.mem.Allocator, hart: usize, size: usize) void {
+    heap.test_hart = hart;
+    var live: [LIVE][]u8 = undefined;
+    for (0..ROUNDS) |_| {
+        for (&live) |*p| p.* = a.alloc(u8, size) catch @panic("out of memory");
+        for (live) |p| a.free(p);
+    }
+}
+
+// ns per alloc and free, of each hart
+fn measure(a: std.mem.Allocator, harts: usize, size: usize) !u64 {
+    var threads: [HARTS]std.Thread = undefined;
+    var timer = try std.time.Timer.start();
+    for (threads[0..harts], 0..) |*t, i| t.* = try std.Thread.spawn(.{}, worker, .{ a, i, size });
+    for (threads[0..harts]) |t| t.join();
+    return timer.read() / (ROUNDS * LIVE);
+}
+
+pub fn main() !void {
+    const out = std.io.getStdOut().writer();
+
+    try out.print("heap: bench, ns/alloc+free per hart\n", .{});
+    try out.print("  size  heap 1  heap {d}  gpa 1  gpa {d}\n", .{ HARTS, HARTS });
+    for (sizes) |n| {
+        var ns: [4]u64 = undefined;
+        for ([_]usize{ 1, HARTS }, 0..) |harts, i| {
+            var h = heap.Heap.init(@intFromPtr(&memory), @intFromPtr(&memory) + memory.len);
+            ns[i] = try measure(h.allocator(), harts, n);
+
+            var gpa = std.heap.GeneralPurposeAllocator(.{ .thread_safe = true }){};
+            defer _ = gpa.deinit();
+            ns[2 + i] = try measure(gpa.allocator(), harts, n);
+        }
+        try out.print("{d: >6}  {d: >6}  {d: >6}  {d: >5}  {d: >5}\n", .{ n, ns[0], ns[1], ns[2], ns[3] });
+    }
+}
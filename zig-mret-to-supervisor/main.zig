@@ -1,11 +1,24 @@
+const options = @import("options");
 const tty = @import("tty.zig");
 const cpu = @import("cpu.zig");
+const mem = @import("mem.zig");
+const bench = @import("bench.zig");
+const stack = @import("stack.zig");
+const heap = @import("heap.zig");
+const exec = @import("exec.zig");
+const trap = @import("trap.zig");
+const uart = @import("uart.zig");
+const tasks = @import("tasks.zig");
 const csr = cpu.csr;
 
-const ALL_ONES = 0xfffffffffffffff;
 const MSTATUS_MMP_MASK = 3 << 11; // privilege bits
 const MSTATUS_MMP_S = 1 << 11; // supervisor
 
+// supervisor software, timer and external interrupts
+const MIDELEG_S = (1 << 1) | (1 << 5) | (1 << 9);
+const MENVCFG = "0x30a";
+const MENVCFG_STCE = 1 << 63;
+
 export fn main() noreturn {
     // at this point only the 3 pointers, global (gp), stack (sp) and thread
     // pointer (tp), have been set up. a little bit more than the bare minium
@@ -29,11 +42,22 @@ export fn main() noreturn {
     // configure the lowest PMP registers to allow the supervirsor to access
     // all memory. PMP is used to check is a given mode is allowed to access a
     // given memory region.. cfg is 8bit and addr is xlen bit. The lowest
-    // register have priority.
-    csr.write("pmpaddr0", ALL_ONES);
-    csr.write("pmpcfg0", ALL_ONES);
+    // register have priority. the first one guards the stack, see stack.zig
+    stack.protect();
+
+    // let supervisor mode read the cycle, time and instret counters
+    csr.write("mcounteren", 0b111);
+
+    // pick the mem* routines, the vector unit must be enabled from here
+    mem.init();
+
+    // hand the supervisor interrupts to supervisor mode, see trap.zig
+    csr.write("mideleg", MIDELEG_S);
 
-    // TODO:configure interupt/exception handling
+    // let supervisor mode program its own timer, with the stimecmp csr of
+    // the sstc extension. the bit stays 0, if the hart does not have it
+    csr.set(MENVCFG, MENVCFG_STCE);
+    exec.sstc = csr.read(MENVCFG) & MENVCFG_STCE != 0;
 
     // mret will return to the adress in MEPC with the mode in MPP
     asm volatile ("mret");
@@ -42,5 +66,22 @@ export fn main() noreturn {
 
 export fn kernel() noreturn {
     tty.println("supervisor mode setup");
-    cpu.hang();
+
+    // until then the heap is empty, and allocations fail
+    if (cpu.hartid() == 0) heap.init();
+
+    if (options.bench and cpu.hartid() == 0) {
+        bench.run();
+        bench.allocs();
+        bench.tasks();
+        stack.report();
+    }
+
+    // hart 0 runs the tasks, the others have nothing to do yet
+    if (cpu.hartid() != 0) cpu.hang();
+
+    trap.init();
+    uart.init();
+    tasks.spawn();
+    exec.run();
 }
@@ -0,0 +1,51 @@
+const cpu = @import("cpu.zig");
+const csr = cpu.csr;
+
+const MISA_V = 1 << ('v' - 'a'); // vector extension
+const MSTATUS_VS_MASK = 3 << 9; // vector unit state
+const MSTATUS_VS_INITIAL = 1 << 9;
+
+// implemented in mem.S. the exported memcpy and memset jump through these
+extern var memcpy_impl: usize;
+extern var memset_impl: usize;
+
+pub const Copy = *const fn (dst: [*]u8, src: [*]const u8, n: usize) callconv(.C) [*]u8;
+pub const Set = *const fn (dst: [*]u8, c: c_int, n: usize) callconv(.C) [*]u8;
+
+extern fn memcpy_scalar(dst: [*]u8, src: [*]const u8, n: usize) callconv(.C) [*]u8;
+extern fn memset_scalar(dst: [*]u8, c: c_int, n: usize) callconv(.C) [*]u8;
+extern fn memcpy_rvv(dst: [*]u8, src: [*]const u8, n: usize) callconv(.C) [*]u8;
+extern fn memset_rvv(dst: [*]u8, c: c_int, n: usize) callconv(.C) [*]u8;
+
+/// probe misa for the vector extension and, if present, switch memcpy and
+/// memset over to the rvv variants. the vector unit is turned on in mstatus,
+/// so this must run in machine mode, on every hart.
+pub fn init() void {
+    if (csr.read("misa") & MISA_V == 0)
+        return;
+
+    csr.clear("mstatus", MSTATUS_VS_MASK);
+    csr.set("mstatus", MSTATUS_VS_INITIAL);
+
+    memcpy_impl = @intFromPtr(&memcpy_rvv);
+    memset_impl = @intFromPtr(&memset_rvv);
+}
+
+pub fn vector() bool {
+    return memcpy_impl == @intFromPtr(&memcpy_rvv);
+}
+
+/// the currently selected routines. calling through these, instead of
+/// @memcpy, keeps the optimizer from eliding repeated copies in benchmarks.
+pub fn copy() Copy {
+    return @ptrFromInt(memcpy_impl);
+}
+
+pub fn set() Set {
+    return @ptrFromInt(memset_impl);
+}
+
+pub const scalar = struct {
+    pub const copy: Copy = &memcpy_scalar;
+    pub const set: Set = &memset_scalar;
+};
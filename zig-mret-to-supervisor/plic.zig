@@ -0,0 +1,36 @@
+// the platform level interrupt controller of qemu's virt machine. every hart
+// has a machine and a supervisor context, only the supervisor ones are used.
+
+const BASE = 0x0c000000;
+const PRIORITY = BASE;
+const ENABLE = BASE + 0x2000;
+const THRESHOLD = BASE + 0x200000;
+const CLAIM = BASE + 0x200004;
+
+pub const UART = 10;
+
+fn reg(addr: usize) *volatile u32 {
+    return @ptrFromInt(addr);
+}
+
+fn context(hart: usize) usize {
+    return 2 * hart + 1;
+}
+
+/// route the uart to the supervisor context of the hart, every source gets
+/// the lowest priority, which is still above the threshold of 0
+pub fn init(hart: usize) void {
+    reg(PRIORITY + UART * 4).* = 1;
+    reg(ENABLE + context(hart) * 0x80 + UART / 32 * 4).* |= 1 << UART % 32;
+    reg(THRESHOLD + context(hart) * 0x1000).* = 0;
+}
+
+/// the highest pending source, or null if there is none
+pub fn claim(hart: usize) ?u32 {
+    const src = reg(CLAIM + context(hart) * 0x1000).*;
+    return if (src == 0) null else src;
+}
+
+pub fn complete(hart: usize, src: u32) void {
+    reg(CLAIM + context(hart) * 0x1000).* = src;
+}
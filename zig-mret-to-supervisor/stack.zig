@@ -0,0 +1,62 @@
+const tty = @import("tty.zig");
+const cpu = @import("cpu.zig");
+const csr = cpu.csr;
+
+// each hart gets an aligned slot past bss, see entry.S and linker.ld. the
+// lowest page of a slot is a guard page, the stack grows down towards it.
+// entry.S paints the whole slot with the canary, so the high-water mark is
+// the lowest word, which does not hold it anymore.
+pub const SLOT = 16 << 10;
+pub const GUARD = 4 << 10;
+pub const SIZE = SLOT - GUARD;
+pub const CANARY: u64 = 0x57ac57ac57ac57ac;
+
+// slots past the harts that booted are not painted and skipped in the report
+const MAX_HARTS = 8;
+
+const ALL_ONES = 0xffffffffffffffff;
+const PMP_NAPOT = 3 << 3;
+const PMP_RWX = 0b111;
+
+extern const @"__stack_top$": u8;
+
+fn slot(hart: usize) [*]u64 {
+    return @ptrFromInt(@intFromPtr(&@"__stack_top$") + hart * SLOT);
+}
+
+/// bytes of the stack the hart touched so far
+pub fn used(hart: usize) usize {
+    const s = slot(hart);
+    var i: usize = GUARD / 8;
+    while (i < SLOT / 8 and s[i] == CANARY) i += 1;
+    return SLOT - i * 8;
+}
+
+/// false, if the hart wrote to its guard page. with protect in place, only
+/// machine mode can
+pub fn guardIntact(hart: usize) bool {
+    for (slot(hart)[0 .. GUARD / 8]) |w| {
+        if (w != CANARY) return false;
+    }
+    return true;
+}
+
+/// deny supervisor and user mode access to the guard page of the calling
+/// hart, with pmp entry 0, and allow all other memory with entry 1. pmp is
+/// per hart, so every hart only guards its own stack. an overflow raises an
+/// access fault, before it reaches bss or the stack below.
+pub fn protect() void {
+    const guard = @intFromPtr(slot(cpu.hartid()));
+    csr.write("pmpaddr0", (guard >> 2) | (GUARD / 8 - 1));
+    csr.write("pmpaddr1", ALL_ONES);
+    csr.write("pmpcfg0", PMP_NAPOT | (PMP_NAPOT | PMP_RWX) << 8);
+}
+
+pub fn report() void {
+    tty.print("stacks: hart, used, size\n");
+    for (0..MAX_HARTS) |h| {
+        if (slot(h)[0] != CANARY) continue;
+        const overflow = if (guardIntact(h)) "" else ", overflowed";
+        tty.printf("  {d}, {d}, {d}{s}\n", .{ h, used(h), SIZE, overflow });
+    }
+}
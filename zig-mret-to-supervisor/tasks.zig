@@ -0,0 +1,118 @@
+const std = @import("std");
+const tty = @import("tty.zig");
+const exec = @import("exec.zig");
+const heap = @import("heap.zig");
+const uart = @import("uart.zig");
+
+// the tasks hart 0 runs: an echo of the uart, tickers which sleep and write
+// a line a few times, and a report of the executor once they are done. all of
+// them wait for the uart or the timer, so the hart mostly idles.
+
+const TICKERS = 8;
+const ROUNDS = 3;
+const PERIOD_NS = 250_000_000;
+const REPORT_NS = (TICKERS + 1) * ROUNDS * PERIOD_NS;
+
+const Echo = struct {
+    task: exec.Task = .{ .poll = poll },
+    state: enum { read, write } = .read,
+    buf: [64]u8 = undefined,
+    len: usize = 0,
+    sent: usize = 0,
+
+    fn poll(t: *exec.Task) exec.Poll {
+        const e: *Echo = @fieldParentPtr("task", t);
+        while (true) switch (e.state) {
+            .read => {
+                e.len = uart.readAsync(t, &e.buf) orelse return .pending;
+                e.sent = 0;
+                e.state = .write;
+            },
+            .write => {
+                if (uart.writeAsync(t, e.buf[0..e.len], &e.sent) == .pending) return .pending;
+                e.state = .read;
+            },
+        };
+    }
+};
+
+const Ticker = struct {
+    task: exec.Task = .{ .poll = poll },
+    state: enum { start, sleep, write } = .start,
+    id: usize,
+    round: usize = 0,
+    deadline: u64 = 0,
+    line: [32]u8 = undefined,
+    len: usize = 0,
+    sent: usize = 0,
+
+    fn poll(t: *exec.Task) exec.Poll {
+        const k: *Ticker = @fieldParentPtr("task", t);
+        while (true) switch (k.state) {
+            .start => {
+                k.deadline = exec.after((k.id + 1) * PERIOD_NS);
+                k.state = .sleep;
+            },
+            .sleep => {
+                if (exec.sleep(t, k.deadline) == .pending) return .pending;
+                k.len = (std.fmt.bufPrint(&k.line, "task {d}: tick {d}\n\r", .{ k.id, k.round }) catch &k.line).len;
+                k.sent = 0;
+                k.state = .write;
+            },
+            .write => {
+                if (uart.writeAsync(t, k.line[0..k.len], &k.sent) == .pending) return .pending;
+                k.round += 1;
+                if (k.round == ROUNDS) {
+                    heap.allocator().destroy(k);
+                    return .done;
+                }
+                k.state = .start;
+            },
+        };
+    }
+};
+
+const Report = struct {
+    task: exec.Task = .{ .poll = poll },
+    state: enum { start, sleep, write } = .start,
+    deadline: u64 = 0,
+    line: [96]u8 = undefined,
+    len: usize = 0,
+    sent: usize = 0,
+
+    fn poll(t: *exec.Task) exec.Poll {
+        const r: *Report = @fieldParentPtr("task", t);
+        while (true) switch (r.state) {
+            .start => {
+                r.deadline = exec.after(REPORT_NS);
+                r.state = .sleep;
+            },
+            .sleep => {
+                if (exec.sleep(t, r.deadline) == .pending) return .pending;
+                r.len = exec.format(&r.line).len;
+                r.sent = 0;
+                r.state = .write;
+            },
+            .write => {
+                if (uart.writeAsync(t, r.line[0..r.len], &r.sent) == .pending) return .pending;
+                return .done;
+            },
+        };
+    }
+};
+
+var echo: Echo = .{};
+var report: Report = .{};
+
+pub fn spawn() void {
+    exec.spawn(&echo.task);
+    for (0..TICKERS) |i| {
+        const k = heap.allocator().create(Ticker) catch {
+            tty.println("tasks: out of memory");
+            break;
+        };
+        k.* = .{ .id = i };
+        exec.spawn(&k.task);
+    }
+    exec.spawn(&report.task);
+}
@@ -0,0 +1,56 @@
+const tty = @import("tty.zig");
+const cpu = @import("cpu.zig");
+const exec = @import("exec.zig");
+const plic = @import("plic.zig");
+const uart = @import("uart.zig");
+const csr = cpu.csr;
+
+const SCAUSE_IRQ = 1 << 63;
+const IRQ_S_TIMER = 5;
+const IRQ_S_EXTERNAL = 9;
+
+const SIE_STIE = 1 << IRQ_S_TIMER;
+const SIE_SEIE = 1 << IRQ_S_EXTERNAL;
+
+// see trap.S
+extern fn strap() void;
+
+/// install the trap vector and take timer and external interrupts, once
+/// sstatus.SIE is set. main delegates them from machine mode
+pub fn init() void {
+    csr.write("stvec", @intFromPtr(&strap));
+    plic.init(cpu.hartid());
+    csr.set("sie", SIE_STIE | SIE_SEIE);
+}
+
+export fn trap() void {
+    const cause = csr.read("scause");
+
+    // no printf here, see tty.printHex
+    if (cause & SCAUSE_IRQ == 0) {
+        tty.print("trap: exception ");
+        tty.printHex(cause);
+        tty.print(", sepc ");
+        tty.printHex(csr.read("sepc"));
+        tty.print(", stval ");
+        tty.printHex(csr.read("stval"));
+        tty.print("\n");
+        cpu.hang();
+    }
+
+    switch (cause & ~@as(usize, SCAUSE_IRQ)) {
+        IRQ_S_TIMER => exec.timerInterrupt(),
+        IRQ_S_EXTERNAL => {
+            const hart = cpu.hartid();
+            while (plic.claim(hart)) |src| {
+                if (src == plic.UART) uart.interrupt();
+                plic.complete(hart, src);
+            }
+        },
+        else => {
+            tty.print("trap: unexpected interrupt ");
+            tty.printHex(cause & ~@as(usize, SCAUSE_IRQ));
+            tty.print("\n");
+        },
+    }
+}
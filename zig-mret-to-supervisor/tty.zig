@@ -1,8 +1,15 @@
+const std = @import("std");
+
 /// qemu's virt machine type places uart at this adress
 const uart: *volatile u8 = @ptrFromInt(0x10000000);
+const lsr: *volatile u8 = @ptrFromInt(0x10000005);
+
+const LSR_THRE = 1 << 5;
 
+/// blocking, for boot and panics. tasks write with uart.writeAsync
 pub fn print(str: []const u8) void {
     for (str) |c| {
+        while (lsr.* & LSR_THRE == 0) {}
         uart.* = c;
     }
 }
@@ -11,3 +18,24 @@ pub fn println(str: []const u8) void {
     print(str);
     print("\n\r");
 }
+
+/// hex digits, straight to the uart. for traps, which must not format: the
+/// buffer copies go through memcpy, which may use the vector registers, and
+/// the trap frame does not save them
+pub fn printHex(v: usize) void {
+    const digits = "0123456789abcdef";
+    print("0x");
+    var shift: usize = @bitSizeOf(usize) - 4;
+    while (shift > 0 and (v >> @intCast(shift)) == 0) shift -= 4;
+    while (true) : (shift -= 4) {
+        while (lsr.* & LSR_THRE == 0) {}
+        uart.* = digits[(v >> @intCast(shift)) & 0xf];
+        if (shift == 0) break;
+    }
+}
+
+/// format into a stack buffer, output longer than the buffer is cut off
+pub fn printf(comptime fmt: []const u8, args: anytype) void {
+    var buf: [256]u8 = undefined;
+    print(std.fmt.bufPrint(&buf, fmt, args) catch &buf);
+}
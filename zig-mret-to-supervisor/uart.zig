@@ -0,0 +1,89 @@
+const exec = @import("exec.zig");
+
+// the 16550 uart of qemu's virt machine, for tasks. reads and writes never
+// spin, a task that would have to wait parks itself on a waiters list, and
+// enables the interrupt which wakes it. tty.zig stays the blocking path for
+// boot and panics.
+
+const BASE = 0x10000000;
+const RBR = 0; // receive buffer, on read
+const THR = 0; // transmit holding, on write
+const IER = 1;
+const FCR = 2;
+const LSR = 5;
+
+const IER_RX = 1 << 0;
+const IER_THRE = 1 << 1;
+const FCR_ENABLE = 1 << 0;
+const FCR_CLEAR = 3 << 1;
+const LSR_DR = 1 << 0;
+const LSR_THRE = 1 << 5;
+
+const FIFO = 16;
+
+var rx: exec.Waiters = .{};
+var tx: exec.Waiters = .{};
+
+fn reg(off: usize) *volatile u8 {
+    return @ptrFromInt(BASE + off);
+}
+
+pub fn init() void {
+    reg(FCR).* = FCR_ENABLE | FCR_CLEAR;
+    reg(IER).* = 0;
+}
+
+/// write buf, as much as the fifo takes. .done once all of it is out, until
+/// then the task is woken whenever the fifo drained. n counts the bytes
+/// written across polls, it starts at 0
+pub fn writeAsync(t: *exec.Task, buf: []const u8, n: *usize) exec.Poll {
+    const s = exec.irqSave();
+    defer exec.irqRestore(s);
+
+    while (n.* < buf.len) {
+        if (reg(LSR).* & LSR_THRE == 0) {
+            tx.wait(t);
+            reg(IER).* |= IER_THRE;
+            return .pending;
+        }
+
+        // the fifo is empty
+        const end = @min(buf.len, n.* + FIFO);
+        for (buf[n.*..end]) |c| reg(THR).* = c;
+        n.* = end;
+    }
+    return .done;
+}
+
+/// read what the fifo holds into buf, at least one byte. null, if it is
+/// empty, the task is woken once a byte arrived
+pub fn readAsync(t: *exec.Task, buf: []u8) ?usize {
+    const s = exec.irqSave();
+    defer exec.irqRestore(s);
+
+    var n: usize = 0;
+    while (n < buf.len and reg(LSR).* & LSR_DR != 0) : (n += 1) {
+        buf[n] = reg(RBR).*;
+    }
+    if (n > 0) return n;
+
+    rx.wait(t);
+    reg(IER).* |= IER_RX;
+    return null;
+}
+
+/// the interrupts are level triggered, and the tasks drain the fifos. so a
+/// source is switched off here, until a task waits for it again
+pub fn interrupt() void {
+    const lsr = reg(LSR).*;
+    const ier = reg(IER);
+
+    if (ier.* & IER_RX != 0 and lsr & LSR_DR != 0) {
+        ier.* &= ~@as(u8, IER_RX);
+        rx.wakeAll();
+    }
+    if (ier.* & IER_THRE != 0 and lsr & LSR_THRE != 0) {
+        ier.* &= ~@as(u8, IER_THRE);
+        tx.wakeAll();
+    }
+}